@@ -0,0 +1,217 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef TMR_SIMULATION
+#include <xc.h>
+
+#if !__is_compiling || __has_include("FreeRTOS.h")
+#include "FreeRTOS.h"
+#endif
+#endif
+
+#include "Timer.h"
+#include "TimerConfig.h"
+#include "SoftTimer.h"
+
+#define STMR_LEVEL_MASK (STMR_SLOTS - 1)
+
+//largest delay that still fits into the wheel without re-cascading
+#define STMR_MAX_DELAY ((uint32_t) (((uint64_t) 1 << (STMR_SLOT_BITS * STMR_LEVELS)) - 1))
+
+//the wheel itself. Every slot is the head of a circular list of timers
+static SoftTimerLink_t wheel[STMR_LEVELS][STMR_SLOTS];
+
+//current tick count
+static volatile uint32_t currentTick = 0;
+
+//hardware timer driving the wheel
+static TimerHandle_t * wheelHandle = NULL;
+
+static void STMR_listInit(SoftTimerLink_t * head){
+    head->next = head;
+    head->prev = head;
+}
+
+static void STMR_listAppend(SoftTimerLink_t * head, SoftTimerLink_t * link){
+    link->next = head;
+    link->prev = head->prev;
+    head->prev->next = link;
+    head->prev = link;
+}
+
+static void STMR_listRemove(SoftTimerLink_t * link){
+    link->prev->next = link->next;
+    link->next->prev = link->prev;
+
+    //a NULL next pointer marks the timer as inactive
+    link->next = NULL;
+    link->prev = NULL;
+}
+
+//moves all timers of a slot into a separate list, so callbacks can safely modify the wheel while we walk it
+static void STMR_listTake(SoftTimerLink_t * head, SoftTimerLink_t * target){
+    if(head->next == head){
+        STMR_listInit(target);
+        return;
+    }
+
+    target->next = head->next;
+    target->prev = head->prev;
+    target->next->prev = target;
+    target->prev->next = target;
+
+    STMR_listInit(head);
+}
+
+//puts a timer into the slot matching its expiry. Must be called with the wheel interrupt disabled
+static void STMR_insert(SoftTimer_t * timer){
+    //a delta of 0 only happens while cascading, the timer then goes into the level 0 slot that is about to be processed
+    uint32_t delta = timer->expiry - currentTick;
+
+    //timers further away than the wheel can cover get parked in the top level and re-cascaded until they are in range
+    uint32_t slotTick = (delta > STMR_MAX_DELAY) ? currentTick + STMR_MAX_DELAY : timer->expiry;
+    if(delta > STMR_MAX_DELAY) delta = STMR_MAX_DELAY;
+
+    //find the lowest level that can cover the delay
+    uint32_t level = 0;
+    while(level < (STMR_LEVELS - 1) && delta >= ((uint32_t) 1 << (STMR_SLOT_BITS * (level + 1)))) level++;
+
+    uint32_t slot = (slotTick >> (STMR_SLOT_BITS * level)) & STMR_LEVEL_MASK;
+    STMR_listAppend(&wheel[level][slot], &timer->link);
+}
+
+//re-distributes all timers of a slot into the lower levels. Returns the index of the slot
+static uint32_t STMR_cascade(uint32_t level){
+    uint32_t slot = (currentTick >> (STMR_SLOT_BITS * level)) & STMR_LEVEL_MASK;
+
+    SoftTimerLink_t list;
+    STMR_listTake(&wheel[level][slot], &list);
+
+    while(list.next != &list){
+        SoftTimerLink_t * link = list.next;
+        STMR_listRemove(link);
+        STMR_insert((SoftTimer_t *) link);
+    }
+
+    return slot;
+}
+
+static uint32_t STMR_isr(TimerHandle_t * handle, uint32_t flags, void * data){
+    STMR_tick();
+    return 0;
+}
+
+//attaches the wheel to an allocated hardware timer
+uint32_t STMR_init(TimerHandle_t * handle){
+    if(!TMR_isHandleAllocated(handle) || wheelHandle != NULL) return pdFAIL;
+
+    for(uint32_t level = 0; level < STMR_LEVELS; level++){
+        for(uint32_t slot = 0; slot < STMR_SLOTS; slot++) STMR_listInit(&wheel[level][slot]);
+    }
+    currentTick = 0;
+
+    if(!TMR_setISR(handle, STMR_isr, NULL)) return pdFAIL;
+    wheelHandle = handle;
+
+    //every period match is one tick of the wheel
+    TMR_setMode(handle, TmrMode_freeRunning);
+    TMR_setIRQEnabled(handle, 1);
+    TMR_setEnabled(handle, 1);
+
+    return pdPASS;
+}
+
+void STMR_deinit(){
+    if(wheelHandle == NULL) return;
+
+    TMR_setIRQEnabled(wheelHandle, 0);
+    TMR_setISR(wheelHandle, NULL, NULL);
+    wheelHandle = NULL;
+}
+
+void STMR_initTimer(SoftTimer_t * timer, SoftTimerCallback_t callback, void * data){
+    timer->link.next = NULL;
+    timer->link.prev = NULL;
+    timer->expiry = 0;
+    timer->period = 0;
+    timer->callback = callback;
+    timer->data = data;
+}
+
+void STMR_startAt(SoftTimer_t * timer, uint32_t deadline, uint32_t period_ticks){
+    //without a hardware timer nothing would ever advance the wheel
+    if(wheelHandle == NULL) return;
+
+    //the wheel is only ever modified by its own interrupt, so keeping that off is enough to make this atomic
+    uint32_t irqEnabled = TMR_isIRQEnabled(wheelHandle);
+    TMR_setIRQEnabled(wheelHandle, 0);
+
+    if(timer->link.next != NULL) STMR_listRemove(&timer->link);
+
+    //deadlines that already passed expire on the next tick
+    if((int32_t) (deadline - currentTick) <= 0) deadline = currentTick + 1;
+
+    timer->expiry = deadline;
+    timer->period = period_ticks;
+    STMR_insert(timer);
+
+    TMR_setIRQEnabled(wheelHandle, irqEnabled);
+}
+
+void STMR_start(SoftTimer_t * timer, uint32_t delay_ticks, uint32_t period_ticks){
+    STMR_startAt(timer, currentTick + delay_ticks, period_ticks);
+}
+
+void STMR_rearm(SoftTimer_t * timer, uint32_t delay_ticks){
+    STMR_startAt(timer, timer->expiry + delay_ticks, timer->period);
+}
+
+void STMR_stop(SoftTimer_t * timer){
+    //without a hardware timer there is no interrupt to keep off, the timer can just be taken out
+    if(wheelHandle == NULL){
+        if(timer->link.next != NULL) STMR_listRemove(&timer->link);
+        return;
+    }
+
+    uint32_t irqEnabled = TMR_isIRQEnabled(wheelHandle);
+    TMR_setIRQEnabled(wheelHandle, 0);
+
+    if(timer->link.next != NULL) STMR_listRemove(&timer->link);
+
+    TMR_setIRQEnabled(wheelHandle, irqEnabled);
+}
+
+uint32_t STMR_isActive(SoftTimer_t * timer){
+    return timer->link.next != NULL;
+}
+
+uint32_t STMR_getTicks(){
+    return currentTick;
+}
+
+void STMR_tick(){
+    currentTick++;
+
+    //did level 0 just wrap around? If so the timers of the next slot in the level above need to be moved down. Same goes for all the levels above that
+    uint32_t slot = currentTick & STMR_LEVEL_MASK;
+    for(uint32_t level = 1; level < STMR_LEVELS && slot == 0; level++){
+        slot = STMR_cascade(level);
+    }
+
+    //now take every timer that expires on this tick out of the wheel
+    SoftTimerLink_t expired;
+    STMR_listTake(&wheel[0][currentTick & STMR_LEVEL_MASK], &expired);
+
+    while(expired.next != &expired){
+        SoftTimer_t * timer = (SoftTimer_t *) expired.next;
+        STMR_listRemove(&timer->link);
+
+        //periodic timers are re-armed before the callback, so it can still stop or re-start them
+        if(timer->period != 0){
+            timer->expiry += timer->period;
+            STMR_insert(timer);
+        }
+
+        if(timer->callback != NULL) timer->callback(timer, timer->data);
+    }
+}
@@ -1,28 +1,97 @@
 #include <stdint.h>
+#include <string.h>
+
+#ifndef TMR_SIMULATION
 #include <xc.h>
 #include <sys/attribs.h>
 
 #if !__is_compiling || __has_include("FreeRTOS.h")
 #include "FreeRTOS.h"
 #include "FreeRTOSConfig.h"
+#include "task.h"
+#endif
 #endif
 
 #include "Timer.h"
 #include "TimerConfig.h"
+#include "TimerTrace.h"
+
+#ifndef TMR_SIMULATION
 #include "util.h"
 #include "System.h"
+#endif
 
 #define Tmr_is32Bit(handle) ((handle->descriptor->type != TmrType_A) && (handle->flags & TMR_FLAG_32BIT_MODE))
 #define TMR_REGS (*handle->descriptor->registerMap)
 
+//maximum number of counts per period, in 32bit mode the master/slave pair counts the full 32bit range
+#define Tmr_maxCount(type, is32Bit) (((type) == TmrType_B_Master && (is32Bit)) ? 0x100000000ull : 0x10000ull)
+
+//number of fractional bits used for clock cycle counts in the period and frequency calculations
+#define TMR_CYCLE_FRACTION_BITS 6
+
 typedef struct{
-    TimerISR_t function;
-    TimerHandle_t * handle;
-    void * data;
+    //two copies of the callback binding. The isr uses the one selected by the lowest bit of sequence, writers fill the other one and then increment sequence
+    TimerIsrBinding_t bindings[2];
+    volatile uint32_t sequence;
+    
+    TimerState_t * handle;
 } TimerISRDescriptor_t;
 
-//array to signal which timer is used and which isn'T
-static uint32_t availableTimers[TMR_NUM_TIMERS] = {[0 ... (TMR_NUM_TIMERS - 1)] = 1};
+//entry of the rate solver cache. key is 0 while the entry is unused or being rewritten
+typedef struct{
+    volatile uint32_t key;
+    uint32_t Frequency_mHz;
+    TmrRateSolution_t solution;
+} TimerRateCacheEntry_t;
+
+//reciprocal of a divisor made by Tmr_makeReciprocal. Dividing by divisor is a multiply by multiplier and a right shift by shift, plus a correction
+typedef struct{
+    uint64_t divisor;
+    uint32_t multiplier;
+    uint32_t shift;
+} TmrReciprocal_t;
+
+#ifndef TMR_RATE_CACHE_SIZE
+#define TMR_RATE_CACHE_SIZE 8
+#endif
+
+#ifndef TMR_PERIOD_QUEUE_SIZE
+#define TMR_PERIOD_QUEUE_SIZE 4
+#endif
+
+#if TMR_PERIOD_QUEUE_SIZE & (TMR_PERIOD_QUEUE_SIZE - 1)
+    #error "TMR_PERIOD_QUEUE_SIZE must be a power of two"
+#endif
+
+#if TMR_PERIOD_QUEUE_SIZE > 0
+//period updates waiting for the next match. head is only written by the producer, tail only by the isr, so no locking is needed
+typedef struct{
+    struct{
+        uint32_t prescaler;
+        uint32_t prValue;
+    } entries[TMR_PERIOD_QUEUE_SIZE];
+    
+    volatile uint32_t head;
+    volatile uint32_t tail;
+} TimerPeriodQueue_t;
+#endif
+
+#if TMR_NUM_TIMERS > 32
+    #error "The allocator keeps one bit per timer in a 32bit word, devices with more than 32 timers aren't supported"
+#endif
+
+#define Tmr_timerBit(timerNumber) (1ul << ((timerNumber) - 1))
+
+//bitmap of free timers, bit n - 1 is set if timer n is available. Only changed inside TMR_ENTER_CRITICAL
+static volatile uint32_t freeTimers = (uint32_t) ((1ull << TMR_NUM_TIMERS) - 1);
+
+//capabilities of the timers in Tmr_TimerMap, worked out on the first Tmr_initAny call
+static uint32_t typeAMask = 0;
+static uint32_t slaveMask = 0;
+static uint32_t masterMask = 0;
+static uint32_t isrMask = 0;
+static uint32_t capabilitiesKnown = 0;
 
 //list of timer ISR callbacks
 static TimerISRDescriptor_t isrDescriptors[TMR_NUM_TIMERS];
@@ -30,292 +99,968 @@ static TimerISRDescriptor_t isrDescriptors[TMR_NUM_TIMERS];
 static uint32_t typeAPrescalersShifts[4] = {0, 3, 6, 8};
 static uint32_t typeBPrescalersShifts[8] = {0, 1, 2, 3, 4, 5, 6, 8};
 
+#if TMR_USE_HANDLE_POOL
+//statically allocated timer states, one per timer. A state always lives in the slot of its timer number so no search is needed
+static TimerState_t handlePool[TMR_NUM_TIMERS];
+#else
+static TimerState_t * handleStates[TMR_NUM_TIMERS];
+#endif
+
+//generation of the current allocation of every timer, odd while it is allocated. Kept outside of the states so a stale handle never reads freed memory
+static volatile uint32_t handleGenerations[TMR_NUM_TIMERS];
+
+//state of the allocation a handle was returned for, or NULL if the handle is invalid or stale. This is the check every call starts with
+static inline TimerState_t * Tmr_resolve(TimerHandle_t * handle){
+    uintptr_t token = (uintptr_t) handle;
+    uint32_t index = (token & TMR_HANDLE_NUMBER_MASK) - 1;
+    if(index >= TMR_NUM_TIMERS || handleGenerations[index] != (token >> TMR_HANDLE_GENERATION_POSITION)) return NULL;
+    
+#if TMR_USE_HANDLE_POOL
+    return &handlePool[index];
+#else
+    return handleStates[index];
+#endif
+}
+
+#if TMR_ENABLE_ISR_STATS
+//counter value at isr entry and the register it comes from. In 32bit mode the slave isr samples the counter of the master. Unallocated timers sample a dummy
+volatile uint32_t Tmr_isrEntryCount[TMR_NUM_TIMERS];
+volatile uint32_t * volatile Tmr_isrCountRegister[TMR_NUM_TIMERS] = {[0 ... (TMR_NUM_TIMERS - 1)] = &Tmr_isrEntryCount[0]};
+
+static TimerIsrStats_t isrStats[TMR_NUM_TIMERS];
+#endif
+
+#if TMR_ENABLE_SEQUENCER
+//running period sequences, indexed like the isrs. The length is 0 while no sequence is running
+static TimerSequence_t sequences[TMR_NUM_TIMERS];
+static volatile uint32_t sequencePositions[TMR_NUM_TIMERS];
+
+//request the timer had before its sequence claimed PR
+static uint32_t sequenceRequests[TMR_NUM_TIMERS];
+static uint32_t sequenceRequestValues[TMR_NUM_TIMERS];
+#endif
+
+#if TMR_PERIOD_QUEUE_SIZE > 0
+//indexed like the isrs, so in 32bit mode the queue is the one of the slave timer
+static TimerPeriodQueue_t periodQueues[TMR_NUM_TIMERS];
+#endif
+
+//peripheral bus clock the timers run from right now, changed with TMR_notifyClockChange
+static volatile uint32_t Tmr_clock_Hz = TMR_CLK_Hz;
+
+//called at the end of TMR_notifyClockChange, NULL marks a free slot
+static TimerClockHook_t clockHooks[TMR_MAX_CLOCK_HOOKS];
+
+//recently solved rates, replaced round robin. Writers claim their slot with an atomic increment of rateCacheNext
+static TimerRateCacheEntry_t rateCache[TMR_RATE_CACHE_SIZE];
+static volatile uint32_t rateCacheNext = 0;
+
+static void Tmr_publishISR(TimerISRDescriptor_t * descriptor, TimerISR_t isr, void * data);
+
 //allocates a specified timer
 TimerHandle_t * Tmr_init(uint32_t timerNumber, uint32_t enable32BitMode){
-	//is the timer even available?
-	if(availableTimers[timerNumber - 1] == 0) return NULL;
+    //does the timer even exist?
+    if(timerNumber == 0 || timerNumber > TMR_NUM_TIMERS) return TMR_INVALID_HANDLE;
+    
+    uint32_t mask = Tmr_timerBit(timerNumber);
     
     //check if conditions for 32bit mode are met if its enabled
     if(enable32BitMode){
-        //is the timer a type b master timer? (This should also imply there is another timer after this, so we ignore the if(timerNumber >= timercount) check) TODO: evaluate if this might not be a good idea anyway
-        if(Tmr_TimerMap[timerNumber - 1].type != TmrType_B_Master) return NULL;
+        //the timer must be a type b master and the timer after it its slave
+        if(Tmr_TimerMap[timerNumber - 1].type != TmrType_B_Master) return TMR_INVALID_HANDLE;
+        if(timerNumber >= TMR_NUM_TIMERS || Tmr_TimerMap[timerNumber].type != TmrType_B_Slave) return TMR_INVALID_HANDLE;
+        
+        mask |= Tmr_timerBit(timerNumber + 1);
     }
+    
+    //take the timer (and its slave) in one go, so two callers can never end up with one half of the same pair each
+    TMR_ENTER_CRITICAL();
+    uint32_t available = (freeTimers & mask) == mask;
+    if(available) freeTimers &= ~mask;
+    TMR_EXIT_CRITICAL();
+    
+	if(!available) return TMR_INVALID_HANDLE;
 	
+#if TMR_USE_HANDLE_POOL
+    //take the pool slot of the timer
+    TimerState_t * ret = &handlePool[timerNumber - 1];
+#else
 	//try to get memory
-	TimerHandle_t * ret = TMR_MALLOC(sizeof(TimerHandle_t));
+	TimerState_t * ret = TMR_MALLOC(sizeof(TimerState_t));
 	
-	//did we actually get memory?
-	if(ret == NULL) return NULL;
-
-	//mark timer(s) as not available
-	availableTimers[timerNumber - 1] = 0;
+	//did we actually get memory? If not give the timers back
+	if(ret == NULL){
+        TMR_ENTER_CRITICAL();
+        freeTimers |= mask;
+        TMR_EXIT_CRITICAL();
+        return TMR_INVALID_HANDLE;
+    }
     
-    //32bit mode also uses the slave timer at timerNumber + 1
-    if(enable32BitMode) availableTimers[timerNumber] = 0;
+    handleStates[timerNumber - 1] = ret;
+#endif
     
     //initialise variables
     ret->descriptor = &Tmr_TimerMap[timerNumber - 1];
 	ret->number = timerNumber;
 	ret->flags = enable32BitMode ? TMR_FLAG_32BIT_MODE : 0;
     ret->currentMode = TmrMode_Off;
+    ret->request = TMR_REQUEST_NONE;
+    
+    //the handle carries the generation of this allocation, so copies of the handles of earlier allocations of the same timer never match it
+    uint32_t generation = (handleGenerations[timerNumber - 1] + 1) & (TMR_HANDLE_GENERATION_MASK >> TMR_HANDLE_GENERATION_POSITION);
+    ret->self = (TimerHandle_t *) (uintptr_t) ((generation << TMR_HANDLE_GENERATION_POSITION) | timerNumber);
     
     //set the 32bit mode bit. If the timer doesn't support it then the write won't do anything
-    ret->descriptor->registerMap->TCON.T32 = enable32BitMode;
+    uint32_t tcon = TMR_REG_READ(ret->descriptor->registerMap->TCON.w) & ~TMR_T32_MASK;
+    TMR_REG_WRITE(ret->descriptor->registerMap->TCON.w, enable32BitMode ? tcon | TMR_T32_MASK : tcon);
+    
+    //load the shadows from the hardware once, from now on all changes go through them
+    ret->tconShadow = TMR_REG_READ(ret->descriptor->registerMap->TCON.w);
+    const TimerDescriptor_t * irqDesc = enable32BitMode ? &Tmr_TimerMap[timerNumber] : ret->descriptor;
+    ret->priorityShadow = (TMR_REG_READ(irqDesc->ipcReg->w) >> irqDesc->ipcOffset) & TMR_PRIORITY_MASK;
     
-    //remember the handle for any interrupts
+    //remember the handle for any interrupts. In 32bit mode those come from the slave timer
     isrDescriptors[timerNumber - 1].handle = ret;
+    if(enable32BitMode) isrDescriptors[timerNumber].handle = ret;
+    
+#if TMR_ENABLE_ISR_STATS
+    //tell the isr entry sampling where to find our counter
+    Tmr_isrCountRegister[timerNumber - 1] = &ret->descriptor->registerMap->TMR;
+    if(enable32BitMode) Tmr_isrCountRegister[timerNumber] = &ret->descriptor->registerMap->TMR;
+    
+    //start without the statistics of the previous user
+    memset(&isrStats[enable32BitMode ? timerNumber : timerNumber - 1], 0, sizeof(TimerIsrStats_t));
+#endif
+    
+#if TMR_PERIOD_QUEUE_SIZE > 0
+    //drop anything a previous user of the timer left in the queue
+    TimerPeriodQueue_t * queue = &periodQueues[enable32BitMode ? timerNumber : timerNumber - 1];
+    queue->tail = queue->head;
+#endif
+    
+#if TMR_ENABLE_SEQUENCER
+    sequences[enable32BitMode ? timerNumber : timerNumber - 1].length = 0;
+#endif
+    
+    //the handle becomes valid only now that the state is complete
+    handleGenerations[timerNumber - 1] = generation;
     
     //return the handle
-    return ret;
+    return ret->self;
 }
 
 //frees a timer
-void TMR_deinit(TimerHandle_t * handle){
-    //did we even get a pointer?
+void TMR_deinit(TimerHandle_t * timer){
+    //retire the handle first, from here on every copy of it is rejected. If several callers race to free the same handle only one gets past this
+    TMR_ENTER_CRITICAL();
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle != NULL) handleGenerations[handle->number - 1] = (handleGenerations[handle->number - 1] + 1) & (TMR_HANDLE_GENERATION_MASK >> TMR_HANDLE_GENERATION_POSITION);
+    TMR_EXIT_CRITICAL();
+    
     if(handle == NULL) return;
     
-    //is there at least a chance the pointer is valid? TODO: perhaps add a software breakpoint here?
-    if(handle->number == 0) return;
+    //reset regs to their semi-default
+    TMR_REG_WRITE(TMR_REGS.TCON.w, 0);
+    TMR_REG_WRITE(TMR_REGS.PR, 0);
+    TMR_REG_WRITE(TMR_REGS.TMR, 0);
     
-    //check if the timer is even still allocated. If it is we need to reset the regs to their semi-default
-    if(availableTimers[handle->number - 1] == 0){
-        //reset regs
-        TMR_REGS.TCON.w = 0;
-        TMR_REGS.PR = 0;
-        TMR_REGS.TMR = 0;
-        
-        
-        //is the timer in 32 bit mode?
-        if(handle->flags & TMR_FLAG_32BIT_MODE){
-            //yes, the timer at number+1 was ours too and also needs to be reset
-            Tmr_TimerMap[handle->number - 1].registerMap->TCON.w = 0;
-            Tmr_TimerMap[handle->number - 1].registerMap->PR = 0;
-            Tmr_TimerMap[handle->number - 1].registerMap->TMR = 0;
-        }
+    //is the timer in 32 bit mode?
+    if(handle->flags & TMR_FLAG_32BIT_MODE){
+        //yes, the timer at number+1 was ours too and also needs to be reset
+        TMR_REG_WRITE(Tmr_TimerMap[handle->number].registerMap->TCON.w, 0);
+        TMR_REG_WRITE(Tmr_TimerMap[handle->number].registerMap->PR, 0);
+        TMR_REG_WRITE(Tmr_TimerMap[handle->number].registerMap->TMR, 0);
     }
     
-    //mark the timer as available again
-    availableTimers[handle->number - 1] = 1;
+    uint32_t mask = Tmr_timerBit(handle->number);
     isrDescriptors[handle->number - 1].handle = NULL;
     
-    //before we free the memory invalidate the pointer, just incase it gets passed to us again on accident
-    handle->number = 0;
+    //the slave timer of a 32bit pair was ours too
+    if(handle->flags & TMR_FLAG_32BIT_MODE){
+        mask |= Tmr_timerBit(handle->number + 1);
+        isrDescriptors[handle->number].handle = NULL;
+    }
+    
+    //the callback belonged to this allocation, the next one starts without any
+    Tmr_publishISR(&isrDescriptors[Tmr_is32Bit(handle) ? handle->number : handle->number - 1], NULL, NULL);
+    
+    //mark the timer(s) as available again
+    TMR_ENTER_CRITICAL();
+    freeTimers |= mask;
+    TMR_EXIT_CRITICAL();
     
+#if !TMR_USE_HANDLE_POOL
     //and finally free the memory
+    handleStates[handle->number - 1] = NULL;
     TMR_FREE(handle);
+#endif
+}
+
+uint32_t TMR_isHandleAllocated(TimerHandle_t * handle){
+    return Tmr_resolve(handle) != NULL;
+}
+
+TimerState_t * TMR_getState(TimerHandle_t * handle){
+    return Tmr_resolve(handle);
 }
 
 //set timer mode
-void TMR_setMode(TimerHandle_t * handle, TimerMode_t mode){
+void TMR_setMode(TimerHandle_t * timer, TimerMode_t mode){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return;
+    
     handle->currentMode = mode;
 }
 
 //switch the timer on or off
-void TMR_setEnabled(TimerHandle_t * handle, uint32_t enabled){
+void TMR_setEnabled(TimerHandle_t * timer, uint32_t enabled){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return;
+    
     //are we switching the timer on or off?
     if(enabled){
-        //clear the on bit (not necessary for the slave timer in 32bit mode as its con register has no effect)
-        handle->descriptor->registerMap->TCONSET.w = _T1CON_TON_MASK;
+        //set the on bit (not necessary for the slave timer in 32bit mode as its con register has no effect)
+        TMR_REG_WRITE(handle->descriptor->registerMap->TCONSET.w, _T1CON_TON_MASK);
+        __sync_fetch_and_or(&handle->tconShadow, _T1CON_TON_MASK);
     }else{
         //clear the on bit
-        handle->descriptor->registerMap->TCONCLR.w = _T1CON_TON_MASK;
+        TMR_REG_WRITE(handle->descriptor->registerMap->TCONCLR.w, _T1CON_TON_MASK);
+        __sync_fetch_and_and(&handle->tconShadow, ~_T1CON_TON_MASK);
     }
 }
 
+//writes the bits in mask of a new TCON image. Only bits that differ from the shadow are written, with CLR and SET writes so a
+//bit changed by an isr in the meantime is never flipped back, and bits outside of mask are never touched at all.
+//The CLR write goes first, so a timer being stopped stops before anything else changes and one being started only starts with the SET
+//write that also carries the rest of the new image. A timer that keeps running would count with just the bits in common for one write
+//(a prescaler of 1:2 going to 1:4 passes 1:1), so it is stopped by the CLR write and started again by the SET write
+static void Tmr_commitTCON(TimerState_t * handle, uint32_t mask, uint32_t tcon){
+    uint32_t shadow = handle->tconShadow;
+    uint32_t setBits = tcon & mask & ~shadow;
+    uint32_t clearBits = ~tcon & mask & shadow;
+    
+    if(setBits && clearBits && (shadow & _T1CON_TON_MASK) && !(clearBits & _T1CON_TON_MASK)){
+        setBits |= _T1CON_TON_MASK;
+        clearBits |= _T1CON_TON_MASK;
+    }
+    
+    if(clearBits){
+        TMR_REG_WRITE(TMR_REGS.TCONCLR.w, clearBits);
+        __sync_fetch_and_and(&handle->tconShadow, ~clearBits);
+    }
+    
+    if(setBits){
+        TMR_REG_WRITE(TMR_REGS.TCONSET.w, setBits);
+        __sync_fetch_and_or(&handle->tconShadow, setBits);
+    }
+}
+
+//same for the interrupt priority bits in the IPC register
+static void Tmr_commitPriority(TimerState_t * handle, uint32_t priorityBits){
+    uint32_t diff = (priorityBits ^ handle->priorityShadow) & TMR_PRIORITY_MASK;
+    if(diff == 0) return;
+    
+    //in 32bit mode all interrupt related settings come from the slave timer
+    const TimerDescriptor_t * desc = Tmr_is32Bit(handle) ? &Tmr_TimerMap[handle->number] : handle->descriptor;
+    TMR_REG_WRITE(desc->ipcReg->INV, diff << desc->ipcOffset);
+    handle->priorityShadow = priorityBits & TMR_PRIORITY_MASK;
+}
+
+//applies a complete timer setup with as few register accesses as possible. The hardware only ever sees the old and the new configuration, never anything in between
+void TMR_configure(TimerHandle_t * timer, const TimerSetup_t * setup){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return;
+    
+    //calculate the final TCON image
+    uint32_t tckpsMask = (handle->descriptor->type == TmrType_A) ? TMR_TYPEA_TCKPS_MASK : TMR_TYPEB_TCKPS_MASK;
+    uint32_t mask = tckpsMask | TMR_TCS_MASK | TMR_TGATE_MASK | TMR_TSYNC_MASK | _T1CON_TON_MASK;
+    uint32_t tcon = (setup->prescaler << TMR_TCKPS_POSITION) & tckpsMask;
+    if(setup->clockSource) tcon |= TMR_TCS_MASK;
+    if(setup->gate) tcon |= TMR_TGATE_MASK;
+    if(setup->sync) tcon |= TMR_TSYNC_MASK;
+    if(setup->enabled) tcon |= _T1CON_TON_MASK;
+    
+    Pic32PrioBits_t priority = {.priority = setup->priority, .subPriority = setup->subPriority};
+    handle->request = TMR_REQUEST_NONE;
+    
+    //switch the interrupt off first if it isn't wanted anymore, so it can't fire with the new settings
+    uint32_t irqEnabled = TMR_isIRQEnabled(timer);
+    if(irqEnabled && !setup->irqEnabled) TMR_setIRQEnabled(timer, 0);
+    
+    //the timer is stopped before PR changes, so the new PR can't reset a running count. One that stays off gets its whole new image right away
+    if(setup->enabled) Tmr_commitTCON(handle, _T1CON_TON_MASK, 0);
+    else Tmr_commitTCON(handle, mask, tcon);
+    
+    handle->currentMode = setup->mode;
+    Tmr_commitPriority(handle, priority.map);
+    TMR_setPR(timer, setup->prValue);
+    
+    //everything else goes in with the final writes, this also starts the timer again if requested
+    Tmr_commitTCON(handle, mask, tcon);
+    
+    if(!irqEnabled && setup->irqEnabled) TMR_setIRQEnabled(timer, 1);
+}
+
 //switch the timer on or off
-uint32_t TMR_isEnabled(TimerHandle_t * handle){
-    return handle->descriptor->registerMap->TCON.ON;
+uint32_t TMR_isEnabled(TimerHandle_t * timer){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return 0;
+    
+    return (TMR_REG_READ(handle->descriptor->registerMap->TCON.w) & _T1CON_TON_MASK) != 0;
 }
 
-//set the desired period of the timer. Returns 1 on success or 0 if the desired period could not be achieved
-uint32_t TMR_setPeriod(TimerHandle_t * handle, uint32_t period_us){
-//first we need to find the best matching prescaler
+//upper bits of the 96bit product of a 64bit and a 32bit value, shifted right by shift (32 to 95). Only needs 32x32 bit multiplies, which the pic32mx does in hardware
+static inline uint64_t Tmr_mulShift(uint64_t value, uint32_t factor, uint32_t shift){
+    uint64_t low = (uint64_t) (uint32_t) value * factor;
+    uint64_t high = (value >> 32) * factor;
     
-    //in order to be able to cover the entire range of possible periods we need to perform the operation in 64bit arithmetic :/
-    uint32_t minScaler = (uint32_t) ((uint64_t) ((uint64_t) TMR_CLK_Hz * (uint64_t) period_us) / (uint64_t) ((uint64_t) 0xffffffff * (uint64_t) 1000000));
+    return (high + (low >> 32)) >> (shift - 32);
+}
+
+//precomputes the reciprocal of a divisor, so dividing by it only takes multiplies. The pic32mx has no 64bit divide instruction, and the generic libgcc helper
+//loops once per bit. The reciprocal is found with Newton-Raphson on the upper 32 bits of the divisor and is kept slightly below the real value,
+//so the quotient estimates are never too large and Tmr_divideBy can correct them from the remainder
+static void Tmr_makeReciprocal(TmrReciprocal_t * reciprocal, uint64_t divisor){
+    reciprocal->divisor = divisor;
+    if(divisor == 0) return;
     
-    //can we even achieve this? 256 is the maximum divider for both timer types
-    if(minScaler > 256){
-        //no, return an error and don't set anything
-        return 0;
+    //normalise the divisor to 2^31 <= top < 2^32, we then need 2^63 / top which lies between 2^31 and 2^32
+    uint32_t leadingZeros = __builtin_clzll(divisor);
+    uint32_t top = (divisor << leadingZeros) >> 32;
+    reciprocal->shift = 95 - leadingZeros;
+    
+    //linear first guess 48/17 - 32/17 * top (scaled), off by at most 1/17. Every step squares the error, three of them get below the 32bit resolution
+    int64_t estimate = 0x169696969ll - (int64_t) (((uint64_t) top * 0xf0f0f0f1u) >> 32);
+    for(uint32_t i = 0; i < 3; i++){
+        int64_t error = (int64_t) ((1ull << 63) - top * (uint64_t) estimate);
+        estimate += (estimate * (error >> 31)) >> 32;
+    }
+    
+    //round the last bits of the estimate so it is exactly floor(2^63 / top). This takes a step or two at most
+    uint64_t product = top * (uint64_t) estimate;
+    while(product > (1ull << 63)){
+        estimate--;
+        product -= top;
     }
+    while((1ull << 63) - product >= top){
+        estimate++;
+        product += top;
+    }
+    
+    //the lower divisor bits that were cut off make the real reciprocal up to 2 smaller, stay below it. 2^32 only happens for a power of two divisor
+    if(estimate > 0xffffffffll) estimate = 0xffffffff;
+    reciprocal->multiplier = (uint32_t) estimate - 2;
+}
+
+//divides by a precomputed reciprocal. Each pass multiplies the remainder by the reciprocal, which has a relative error below 2^-28, so after three passes
+//at most two units are left to correct. That is a fixed number of multiplies instead of one loop per quotient bit
+static uint64_t Tmr_divideBy(uint64_t numerator, const TmrReciprocal_t * reciprocal){
+    uint64_t divisor = reciprocal->divisor;
+    if(divisor == 0) return UINT64_MAX;
     
+    uint64_t quotient = 0;
+    for(uint32_t i = 0; i < 3 && numerator >= divisor; i++){
+        //never above the real quotient, so the product can't overflow and the remainder stays positive
+        uint64_t part = Tmr_mulShift(numerator, reciprocal->multiplier, reciprocal->shift);
+        quotient += part;
+        numerator -= part * divisor;
+    }
     
-    uint32_t selectedScaler = 0;
-    //now check which one of the dividers is the lowest one thats over the minimum
-    if(handle->descriptor->type == TmrType_A){
-        for(uint32_t i = 0; i < arraySize(typeAPrescalersShifts); i++){
-            if((1 << typeAPrescalersShifts[i]) >= minScaler){
-                selectedScaler = i;
-                break;
-            }
+    while(numerator >= divisor){
+        quotient++;
+        numerator -= divisor;
+    }
+    
+    return quotient;
+}
+
+//unsigned 64bit division for divisors that are only used once
+static uint64_t Tmr_divide(uint64_t numerator, uint64_t denominator){
+    if(numerator < denominator) return 0;
+    
+    TmrReciprocal_t reciprocal;
+    Tmr_makeReciprocal(&reciprocal, denominator);
+    return Tmr_divideBy(numerator, &reciprocal);
+}
+
+//returns the divider shift of the prescaler currently set in the timer
+static uint32_t Tmr_getPrescalerShift(TimerState_t * handle){
+    uint32_t tcon = TMR_REG_READ(TMR_REGS.TCON.w);
+    if(handle->descriptor->type == TmrType_A) return typeAPrescalersShifts[(tcon & TMR_TYPEA_TCKPS_MASK) >> TMR_TCKPS_POSITION];
+    return typeBPrescalersShifts[(tcon & TMR_TYPEB_TCKPS_MASK) >> TMR_TCKPS_POSITION];
+}
+
+//finds the prescaler and PR value that get closest to a period of cycles peripheral clocks (in fixed point with TMR_CYCLE_FRACTION_BITS fractional bits).
+//Returns the number of clocks the selected setting actually counts, or 0 if the period can't be reached at all
+static uint64_t Tmr_solveCycles(TimerType_t type, uint32_t is32Bit, uint64_t cycles, uint32_t * prescaler, uint32_t * prValue){
+    const uint32_t * shifts = (type == TmrType_A) ? typeAPrescalersShifts : typeBPrescalersShifts;
+    uint32_t shiftCount = (type == TmrType_A) ? arraySize(typeAPrescalersShifts) : arraySize(typeBPrescalersShifts);
+    
+    uint64_t bestError = UINT64_MAX;
+    uint64_t bestCycles = 0;
+    
+    //check every prescaler and keep the one with the smallest quantisation error
+    for(uint32_t i = 0; i < shiftCount; i++){
+        //round to the nearest count
+        uint64_t counts = ((cycles >> shifts[i]) + (1 << (TMR_CYCLE_FRACTION_BITS - 1))) >> TMR_CYCLE_FRACTION_BITS;
+        if(counts < 2 || counts > Tmr_maxCount(type, is32Bit)) continue;
+        
+        uint64_t achieved = counts << (shifts[i] + TMR_CYCLE_FRACTION_BITS);
+        uint64_t error = (achieved > cycles) ? achieved - cycles : cycles - achieved;
+        
+        if(error < bestError){
+            bestError = error;
+            bestCycles = counts << shifts[i];
+            *prescaler = i;
+            *prValue = (uint32_t) (counts - 1);
         }
+    }
+    
+    return bestCycles;
+}
+
+//works out which timers have which capabilities. Tmr_TimerMap is constant so this only needs to happen once
+static void Tmr_loadCapabilities(){
+    for(uint32_t i = 0; i < TMR_NUM_TIMERS; i++){
+        if(Tmr_TimerMap[i].type == TmrType_A) typeAMask |= Tmr_timerBit(i + 1);
+        if(Tmr_TimerMap[i].type == TmrType_B_Slave) slaveMask |= Tmr_timerBit(i + 1);
+        
+        //a master can only run in 32bit mode if its slave comes right after it
+        if(Tmr_TimerMap[i].type == TmrType_B_Master && i + 1 < TMR_NUM_TIMERS && Tmr_TimerMap[i + 1].type == TmrType_B_Slave) masterMask |= Tmr_timerBit(i + 1);
+        
+#ifdef configTICK_INTERRUPT_VECTOR
+        //the isr of the timer freeRtos uses for its tick isn't generated in TimerConfig.c
+        if(Tmr_TimerMap[i].interruptVector == configTICK_INTERRUPT_VECTOR) continue;
+#endif
+        isrMask |= Tmr_timerBit(i + 1);
+    }
+    
+    capabilitiesKnown = 1;
+}
+
+//checks if any prescaler of a timer type can count periods from minCycles to maxCycles with counts no longer than resolutionCycles
+static uint32_t Tmr_canMeet(TimerType_t type, uint32_t is32Bit, uint64_t minCycles, uint64_t maxCycles, uint64_t resolutionCycles){
+    const uint32_t * shifts = (type == TmrType_A) ? typeAPrescalersShifts : typeBPrescalersShifts;
+    uint32_t shiftCount = (type == TmrType_A) ? arraySize(typeAPrescalersShifts) : arraySize(typeBPrescalersShifts);
+    
+    for(uint32_t i = 0; i < shiftCount; i++){
+        if((1ull << shifts[i]) > resolutionCycles) break;
+        
+        //the shortest period is two counts (PR = 1), the longest the full counter
+        if(minCycles >= (2ull << shifts[i]) && maxCycles <= (Tmr_maxCount(type, is32Bit) << shifts[i])) return 1;
+    }
+    
+    return 0;
+}
+
+TimerHandle_t * Tmr_initAny(const TimerRequirements_t * requirements){
+    if(!capabilitiesKnown) Tmr_loadCapabilities();
+    
+    if(requirements->irqPriority > 7) return TMR_INVALID_HANDLE;
+    
+    uint32_t is32Bit = requirements->need32Bit;
+    uint32_t required = requirements->irqPriority ? isrMask : 0xffffffff;
+    
+    //convert the requirements into peripheral clocks. Anything left at 0 is no restriction
+    uint64_t minCycles = requirements->minPeriod_us ? Tmr_divide((uint64_t) Tmr_clock_Hz * requirements->minPeriod_us, 1000000) : UINT64_MAX;
+    uint64_t maxCycles = Tmr_divide((uint64_t) Tmr_clock_Hz * requirements->maxPeriod_us, 1000000);
+    uint64_t resolutionCycles = requirements->resolution_ns ? Tmr_divide((uint64_t) Tmr_clock_Hz * requirements->resolution_ns, 1000000000) : UINT64_MAX;
+    
+    //collect the timers that could do it, in the order they should be preferred. Slaves first so masters stay available for 32bit pairs, type A last as it is the only one that can count asynchronously
+    uint32_t candidates[3] = {0, 0, 0};
+    
+    if(is32Bit){
+        if(Tmr_canMeet(TmrType_B_Master, 1, minCycles, maxCycles, resolutionCycles)) candidates[0] = masterMask;
+    }else if(requirements->needAsyncClock){
+        //only type A timers can count an external clock without synchronising it to the peripheral clock
+        if(Tmr_canMeet(TmrType_A, 0, minCycles, maxCycles, resolutionCycles)) candidates[0] = typeAMask;
     }else{
-        for(uint32_t i = 0; i < arraySize(typeBPrescalersShifts); i++){
-            if((1 << typeBPrescalersShifts[i]) >= minScaler){
-                selectedScaler = i;
-                break;
+        //external clock and gate are available on every timer
+        if(Tmr_canMeet(TmrType_B_Slave, 0, minCycles, maxCycles, resolutionCycles)){
+            candidates[0] = slaveMask;
+            candidates[1] = masterMask;
+        }
+        if(Tmr_canMeet(TmrType_A, 0, minCycles, maxCycles, resolutionCycles)) candidates[2] = typeAMask;
+    }
+    
+    for(uint32_t i = 0; i < arraySize(candidates); i++){
+        uint32_t free = freeTimers & candidates[i] & required;
+        
+        //a 32bit pair also needs its slave to be free, which is the bit right above the one of the master
+        if(is32Bit) free &= freeTimers >> 1;
+        
+        while(free != 0){
+            uint32_t timerNumber = __builtin_ctz(free) + 1;
+            
+            //someone else might have been faster, Tmr_init does the actual reservation
+            TimerHandle_t * ret = Tmr_init(timerNumber, is32Bit);
+            if(ret != TMR_INVALID_HANDLE){
+                if(requirements->irqPriority) TMR_setInterruptPriority(ret, requirements->irqPriority, 0);
+                return ret;
             }
+            
+            free &= ~Tmr_timerBit(timerNumber);
         }
     }
     
+    return TMR_INVALID_HANDLE;
+}
+
+//set the desired period of the timer. Returns 1 on success or 0 if the desired period could not be achieved
+static uint64_t Tmr_solvePeriod(TimerState_t * handle, uint32_t period_us, uint32_t * prescaler, uint32_t * prValue){
+    //number of peripheral clocks in the period. 1000000 / 2^6 = 15625 so dividing by that directly gives us the fractional bits
+    uint64_t cycles = Tmr_divide((uint64_t) Tmr_clock_Hz * (uint64_t) period_us, 1000000 >> TMR_CYCLE_FRACTION_BITS);
+    
+    return Tmr_solveCycles(handle->descriptor->type, Tmr_is32Bit(handle), cycles, prescaler, prValue);
+}
+
+//writes new period settings with the timer off, so it never counts with the new prescaler and the old PR or the other way round.
+//The request is left to the caller, TMR_setPrescalerAndPR would drop the one a clock change is solving for
+static void Tmr_applyPeriod(TimerState_t * handle, uint32_t prescaler, uint32_t prValue){
+    uint32_t enabled = handle->tconShadow & _T1CON_TON_MASK;
+    
+    if(enabled) TMR_setEnabled(handle->self, 0);
+    TMR_setPrescaler(handle->self, prescaler);
+    TMR_setPR(handle->self, prValue);
+    if(enabled) TMR_setEnabled(handle->self, 1);
+}
+
+uint32_t TMR_setPeriod(TimerHandle_t * timer, uint32_t period_us){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return 0;
+    
+    uint32_t prescaler = 0;
+    uint32_t prValue = 0;
+    if(Tmr_solvePeriod(handle, period_us, &prescaler, &prValue) == 0){
+        //can't be done, return an error and don't set anything
+        return 0;
+    }
+    
+    Tmr_applyPeriod(handle, prescaler, prValue);
+    
+    //remember what was asked for, so the period can be kept if the clock changes
+    handle->request = TMR_REQUEST_PERIOD_US;
+    handle->requestValue = period_us;
+    return 1;
+}
+
+//finds the prescaler and PR value that get closest to a frequency on a given timer type. Results are cached, so asking for the same rate again only costs a lookup
+uint32_t TMR_findClosestRate(TimerType_t type, uint32_t is32Bit, uint32_t Frequency_mHz, TmrRateSolution_t * solution){
+    if(Frequency_mHz == 0) return 0;
+    
+    //timer type and mode make up the cache key, the 0x80 bit makes sure a valid key is never 0
+    uint32_t key = 0x80 | (type << 1) | ((type == TmrType_B_Master && is32Bit) ? 1 : 0);
+    
+    //did we solve this one recently?
+    for(uint32_t i = 0; i < TMR_RATE_CACHE_SIZE; i++){
+        TimerRateCacheEntry_t * entry = &rateCache[i];
+        if(entry->key != key || entry->Frequency_mHz != Frequency_mHz) continue;
+        
+        //the barriers keep the copy between the two checks, neither the compiler nor the cpu may move it out
+        __sync_synchronize();
+        *solution = entry->solution;
+        __sync_synchronize();
+        
+        //make sure nobody rewrote the entry while we were copying it
+        if(entry->key == key && entry->Frequency_mHz == Frequency_mHz) return solution->Frequency_mHz;
+    }
+    
+    //no, search all prescalers. First get the peripheral clocks per period in fixed point
+    //the requested frequency is divided by twice, so its reciprocal is only made once
+    TmrReciprocal_t perFrequency;
+    Tmr_makeReciprocal(&perFrequency, Frequency_mHz);
     
-//now calculate the required period register value
+    uint64_t clk_mHz = (uint64_t) Tmr_clock_Hz * 1000;
+    uint64_t cycles = Tmr_divideBy(clk_mHz << TMR_CYCLE_FRACTION_BITS, &perFrequency);
     
-    //scaler is now selected such that the divider value will not exceed the maximum period count. As that is 32bit we also won't exceed a uint32_t and thus don't need 64bit arithmetic
-    uint32_t divider = (TMR_CLK_Hz >> typeAPrescalersShifts[selectedScaler]) * period_us;
+    uint64_t achievedCycles = Tmr_solveCycles(type, is32Bit, cycles, &solution->prescaler, &solution->prValue);
+    if(achievedCycles == 0) return 0;
     
+    //frequency we'll actually get, rounded to the nearest mHz. Rounding to the closest PR can land above what fits into the 32bit result, that is reported as the largest value instead of wrapping
+    uint64_t achieved_mHz = Tmr_divide(clk_mHz + (achievedCycles >> 1), achievedCycles);
+    solution->Frequency_mHz = (achieved_mHz > UINT32_MAX) ? UINT32_MAX : (uint32_t) achieved_mHz;
     
-//finally write the values to the timer
+    //the error is taken from the real value, not the saturated one
+    uint64_t difference = (achieved_mHz > Frequency_mHz) ? achieved_mHz - Frequency_mHz : Frequency_mHz - achieved_mHz;
+    uint64_t ppm = Tmr_divideBy(difference * 1000000, &perFrequency);
+    if(ppm > INT32_MAX) ppm = INT32_MAX;
+    solution->error_ppm = (achieved_mHz > Frequency_mHz) ? (int32_t) ppm : -(int32_t) ppm;
     
-    //make sure the timer is off while we update the registers
-    uint32_t state = TMR_isEnabled(handle);
-    TMR_setEnabled(handle, 0);
+    //remember the result. The key is cleared while the entry is rewritten so no half written entry can ever match
+    //taking the slot atomically keeps two callers (task and isr) from rewriting the same entry at once
+    TimerRateCacheEntry_t * entry = &rateCache[__sync_fetch_and_add(&rateCacheNext, 1) % TMR_RATE_CACHE_SIZE];
     
-    TMR_setPrescaler(handle, selectedScaler);
-    TMR_setPR(handle, divider);
+    entry->key = 0;
+    __sync_synchronize();
+    entry->Frequency_mHz = Frequency_mHz;
+    entry->solution = *solution;
+    __sync_synchronize();
+    entry->key = key;
     
-    if(state) TMR_setEnabled(handle, 1);
+    return solution->Frequency_mHz;
 }
 
-uint32_t TMR_setFrequency(TimerHandle_t * handle, uint32_t Frequency_mHz){
-    //TODO
+//calculates the prescaler and PR value for a frequency without touching the timer. Returns the frequency that will actually be reached (or 0 if it can't be) and the error relative to the requested one
+uint32_t TMR_calculateFrequency(TimerHandle_t * timer, uint32_t Frequency_mHz, uint32_t * prescaler, uint32_t * prValue, int32_t * error_ppm){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return 0;
+    
+    TmrRateSolution_t solution;
+    if(TMR_findClosestRate(handle->descriptor->type, Tmr_is32Bit(handle), Frequency_mHz, &solution) == 0) return 0;
+    
+    *prescaler = solution.prescaler;
+    *prValue = solution.prValue;
+    if(error_ppm != NULL) *error_ppm = solution.error_ppm;
+    
+    return solution.Frequency_mHz;
 }
 
-uint32_t TMR_getPeriod_us(TimerHandle_t * handle){
-    //calculate the clocks period in nanoseconds
-    uint32_t clockPeriod_ns = 1000000000 / TMR_CLK_Hz;
+//set the desired frequency of the timer. Returns the frequency that was actually set or 0 if the requested one could not be achieved
+uint32_t TMR_setFrequency(TimerHandle_t * timer, uint32_t Frequency_mHz){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return 0;
+    
+    uint32_t prescaler = 0;
+    uint32_t prValue = 0;
+    
+    uint32_t achieved_mHz = TMR_calculateFrequency(timer, Frequency_mHz, &prescaler, &prValue, NULL);
+    if(achieved_mHz == 0) return 0;
+    
+    Tmr_applyPeriod(handle, prescaler, prValue);
+    
+    handle->request = TMR_REQUEST_FREQUENCY_mHz;
+    handle->requestValue = Frequency_mHz;
+    return achieved_mHz;
+}
+
+//returns the rate the counter register counts at, so the peripheral clock after the prescaler
+uint32_t TMR_getCountFrequency_Hz(TimerHandle_t * timer){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return 0;
+    
+    return Tmr_clock_Hz >> Tmr_getPrescalerShift(handle);
+}
+
+uint32_t TMR_getFrequency_mHz(TimerHandle_t * timer){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return 0;
+    
+    //number of peripheral clocks in one period
+    uint64_t cycles = ((uint64_t) TMR_REG_READ(TMR_REGS.PR) + 1) << Tmr_getPrescalerShift(handle);
     
-    //get the prescaler
-    uint32_t scaler = 1;
-    if(handle->descriptor->type == TmrType_A){
-        scaler = 1 << typeAPrescalersShifts[handle->descriptor->registerMap->TCON.TYPEA_TCKPS];
+    //a PR of 0 on a fast clock lands above what fits into the result, report the largest value instead of wrapping like TMR_findClosestRate does
+    uint64_t frequency_mHz = Tmr_divide((uint64_t) Tmr_clock_Hz * 1000 + (cycles >> 1), cycles);
+    return (frequency_mHz > UINT32_MAX) ? UINT32_MAX : (uint32_t) frequency_mHz;
+}
+
+uint32_t TMR_getPeriod_us(TimerHandle_t * timer){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return 0;
+    
+    //number of peripheral clocks in one period
+    uint64_t cycles = ((uint64_t) TMR_REG_READ(TMR_REGS.PR) + 1) << Tmr_getPrescalerShift(handle);
+    
+    uint64_t period_us = Tmr_divide(cycles * 1000000, Tmr_clock_Hz);
+    return (period_us > UINT32_MAX) ? UINT32_MAX : (uint32_t) period_us;
+}
+
+uint32_t TMR_getClock_Hz(){
+    return Tmr_clock_Hz;
+}
+
+//finds the prescaler with exactly the given divider shift. Returns 0 if the timer doesn't have one
+static uint32_t Tmr_findPrescaler(TimerState_t * handle, uint32_t shift, uint32_t * prescaler){
+    const uint32_t * shifts = (handle->descriptor->type == TmrType_A) ? typeAPrescalersShifts : typeBPrescalersShifts;
+    uint32_t shiftCount = (handle->descriptor->type == TmrType_A) ? arraySize(typeAPrescalersShifts) : arraySize(typeBPrescalersShifts);
+    
+    for(uint32_t i = 0; i < shiftCount; i++){
+        if(shifts[i] != shift) continue;
+        *prescaler = i;
+        return 1;
+    }
+    
+    return 0;
+}
+
+//works out the settings that keep a timer's timing the same with the new clock and applies them
+static void Tmr_rescale(TimerState_t * handle, uint32_t oldClock_Hz){
+    uint32_t prescaler = 0;
+    uint32_t prValue = 0;
+    
+    if(handle->request == TMR_REQUEST_PERIOD_US){
+        if(Tmr_solvePeriod(handle, handle->requestValue, &prescaler, &prValue) == 0) return;
+    }else if(handle->request == TMR_REQUEST_FREQUENCY_mHz){
+        if(TMR_calculateFrequency(handle->self, handle->requestValue, &prescaler, &prValue, NULL) == 0) return;
     }else{
-        scaler = 1 << typeBPrescalersShifts[handle->descriptor->registerMap->TCON.TYPEB_TCKPS];
+        //we don't know what the timer is used for, but if the clock changed by a power of two a different prescaler keeps the count rate and with that everything else the same.
+        //PR may belong to an isr (see TMR_claimPR), so it is left alone and the prescaler goes in right away, the count rate changed with the clock already
+        uint32_t shift = Tmr_getPrescalerShift(handle);
+        if(Tmr_clock_Hz > oldClock_Hz && Tmr_clock_Hz == (oldClock_Hz << __builtin_ctz(Tmr_clock_Hz / oldClock_Hz))) shift += __builtin_ctz(Tmr_clock_Hz / oldClock_Hz);
+        else if(Tmr_clock_Hz < oldClock_Hz && oldClock_Hz == (Tmr_clock_Hz << __builtin_ctz(oldClock_Hz / Tmr_clock_Hz)) && shift >= __builtin_ctz(oldClock_Hz / Tmr_clock_Hz)) shift -= __builtin_ctz(oldClock_Hz / Tmr_clock_Hz);
+        else return;
+        
+        if(Tmr_findPrescaler(handle, shift, &prescaler)) TMR_setPrescaler(handle->self, prescaler);
+        return;
     }
     
-    //calculate the period. This must once again be done in 64bit arithmetic :/
-    uint32_t period_us = (uint32_t) ((uint64_t) ((uint64_t) clockPeriod_ns * (uint64_t) scaler * (uint64_t) handle->descriptor->registerMap->PR) / (uint64_t) 1000);
+#if TMR_PERIOD_QUEUE_SIZE > 0
+    //a running timer with its interrupt on gets the new settings at the end of its current period, so the period that is running isn't cut short
+    if(TMR_isEnabled(handle->self) && TMR_isIRQEnabled(handle->self)){
+        TMR_flushPeriodQueue(handle->self);
+        TMR_queuePrescalerAndPR(handle->self, prescaler, prValue);
+        return;
+    }
+#endif
     
-    return period_us;
+    Tmr_applyPeriod(handle, prescaler, prValue);
 }
 
-uint32_t TMR_setCustomDivider(TimerHandle_t * handle, uint32_t preScaler, uint32_t divider){
-    //TODO
+void TMR_notifyClockChange(uint32_t newClock_Hz){
+    if(newClock_Hz == 0 || newClock_Hz == Tmr_clock_Hz) return;
+    
+    uint32_t oldClock_Hz = Tmr_clock_Hz;
+    Tmr_clock_Hz = newClock_Hz;
+    
+    //every cached rate was solved for the old clock
+    for(uint32_t i = 0; i < TMR_RATE_CACHE_SIZE; i++) rateCache[i].key = 0;
+    __sync_synchronize();
+    
+    //every allocated handle is in the isr list, a 32bit pair is in there twice so only take it from the slot of its master
+    for(uint32_t i = 0; i < TMR_NUM_TIMERS; i++){
+        TimerState_t * handle = isrDescriptors[i].handle;
+        if(handle == NULL || handle->number != i + 1) continue;
+        
+        Tmr_rescale(handle, oldClock_Hz);
+    }
+    
+    //the timers count at their new rates now, so the hooks can read them back
+    for(uint32_t i = 0; i < TMR_MAX_CLOCK_HOOKS; i++){
+        TimerClockHook_t hook = clockHooks[i];
+        if(hook != NULL) (*hook)(oldClock_Hz, newClock_Hz);
+    }
+}
+
+uint32_t TMR_addClockHook(TimerClockHook_t hook){
+    if(hook == NULL) return pdFAIL;
+    
+    TMR_ENTER_CRITICAL();
+    uint32_t freeSlot = TMR_MAX_CLOCK_HOOKS;
+    for(uint32_t i = 0; i < TMR_MAX_CLOCK_HOOKS; i++){
+        if(clockHooks[i] == hook){
+            TMR_EXIT_CRITICAL();
+            return pdPASS;
+        }
+        
+        if(clockHooks[i] == NULL && freeSlot == TMR_MAX_CLOCK_HOOKS) freeSlot = i;
+    }
+    
+    if(freeSlot < TMR_MAX_CLOCK_HOOKS) clockHooks[freeSlot] = hook;
+    TMR_EXIT_CRITICAL();
+    
+    return (freeSlot < TMR_MAX_CLOCK_HOOKS) ? pdPASS : pdFAIL;
+}
+
+void TMR_removeClockHook(TimerClockHook_t hook){
+    TMR_ENTER_CRITICAL();
+    for(uint32_t i = 0; i < TMR_MAX_CLOCK_HOOKS; i++) if(clockHooks[i] == hook) clockHooks[i] = NULL;
+    TMR_EXIT_CRITICAL();
+}
+
+//sets the prescaler (TCKPS value) and the number of counts per period directly. Returns 1 on success or 0 if either is out of range for the timer
+uint32_t TMR_setCustomDivider(TimerHandle_t * timer, uint32_t preScaler, uint32_t divider){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return 0;
+    
+    uint32_t prescalerCount = (handle->descriptor->type == TmrType_A) ? arraySize(typeAPrescalersShifts) : arraySize(typeBPrescalersShifts);
+    
+    if(preScaler >= prescalerCount) return 0;
+    if(divider < 2 || divider > Tmr_maxCount(handle->descriptor->type, Tmr_is32Bit(handle))) return 0;
+    
+    //same path as a period set in us, so the timer never counts with half of the new settings
+    Tmr_applyPeriod(handle, preScaler, divider - 1);
+    
+    //the divider isn't tied to a period, so on a clock change only the count rate is kept
+    handle->request = TMR_REQUEST_NONE;
+    return 1;
 }
 
 //assign an interrupt routine to a timer. To de-assign call with isr* = NULL
-uint32_t TMR_setISR(TimerHandle_t * handle, TimerISR_t isr, void * data){
+//publishes a new binding in the unused slot. The isr never sees a function with the data of another binding
+static void Tmr_publishISR(TimerISRDescriptor_t * descriptor, TimerISR_t isr, void * data){
+    uint32_t next = (descriptor->sequence + 1) & 1;
+    descriptor->bindings[next].function = isr;
+    descriptor->bindings[next].data = data;
+    
+    //the binding must be complete before the isr can pick it
+    __sync_synchronize();
+    descriptor->sequence++;
+}
+
+uint32_t TMR_setISR(TimerHandle_t * timer, TimerISR_t isr, void * data){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return 0;
+    
     //what number does the isr need to be assigned to?
     uint32_t timerNumber = handle->number-1;
     if(Tmr_is32Bit(handle)) timerNumber = handle->number;
     
-    //are we assigning or de-assigning?
-    if(isr == NULL){
-        //write NULL into the isr list for the function and we're done
-        isrDescriptors[timerNumber].function = NULL;
-    }else{
-        //is there already a function assigned? If so we won't overwrite it
-        if(isrDescriptors[timerNumber].function != NULL) return pdFAIL;
-        
-        //assign the function and data
-        isrDescriptors[timerNumber].function = isr;
-        isrDescriptors[timerNumber].data = data;
-    }
+    TimerISRDescriptor_t * descriptor = &isrDescriptors[timerNumber];
+    
+    //is there already a function assigned? If so we won't overwrite it, TMR_swapISR does that
+    if(isr != NULL && descriptor->bindings[descriptor->sequence & 1].function != NULL) return pdFAIL;
+    
+    Tmr_publishISR(descriptor, isr, data);
     
     return pdPASS;
 }
 
-void TMR_setIRQEnabled(TimerHandle_t * handle, uint32_t on){
-    TimerDescriptor_t * desc = Tmr_is32Bit(handle) ? &Tmr_TimerMap[handle->number] : handle->descriptor;
+TimerIsrBinding_t TMR_swapISR(TimerHandle_t * timer, TimerISR_t isr, void * data){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return (TimerIsrBinding_t){NULL, NULL};
+    
+    TimerISRDescriptor_t * descriptor = &isrDescriptors[Tmr_is32Bit(handle) ? handle->number : handle->number - 1];
+    
+    //only writers change the binding, so the current one can't change under us
+    TimerIsrBinding_t old = descriptor->bindings[descriptor->sequence & 1];
+    Tmr_publishISR(descriptor, isr, data);
+    
+    return old;
+}
+
+TimerIsrBinding_t TMR_getISR(TimerHandle_t * timer){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return (TimerIsrBinding_t){NULL, NULL};
+    
+    TimerISRDescriptor_t * descriptor = &isrDescriptors[Tmr_is32Bit(handle) ? handle->number : handle->number - 1];
+    return descriptor->bindings[descriptor->sequence & 1];
+}
+
+void TMR_setIRQEnabled(TimerHandle_t * timer, uint32_t on){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return;
+    
+    const TimerDescriptor_t * desc = Tmr_is32Bit(handle) ? &Tmr_TimerMap[handle->number] : handle->descriptor;
     
     if(on){
-        desc->iecReg->SET = desc->intMask;
+        TMR_REG_WRITE(desc->iecReg->SET, desc->intMask);
     }else{
-        desc->iecReg->CLR = desc->intMask;
+        TMR_REG_WRITE(desc->iecReg->CLR, desc->intMask);
     }
 }
 
 void TMR_setIRQEnabledByNumber(uint32_t number, uint32_t on){
-    TimerDescriptor_t * desc = (Tmr_TimerMap[number-1].registerMap->TCON.T32) ? &Tmr_TimerMap[number] : &Tmr_TimerMap[number - 1];
+    const TimerDescriptor_t * desc = (TMR_REG_READ(Tmr_TimerMap[number-1].registerMap->TCON.w) & TMR_T32_MASK) ? &Tmr_TimerMap[number] : &Tmr_TimerMap[number - 1];
     
     if(on){
-        desc->iecReg->SET = desc->intMask;
+        TMR_REG_WRITE(desc->iecReg->SET, desc->intMask);
     }else{
-        desc->iecReg->CLR = desc->intMask;
+        TMR_REG_WRITE(desc->iecReg->CLR, desc->intMask);
     }
 }
 
-uint32_t TMR_isIRQEnabled(TimerHandle_t * handle){
+uint32_t TMR_isIRQEnabled(TimerHandle_t * timer){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return 0;
+    
     //is the timer in 32Bit mode? If so the isr data comes from the slave timer
-    if(Tmr_is32Bit(handle)) return (Tmr_TimerMap[handle->number].iecReg->w & Tmr_TimerMap[handle->number].intMask) > 0;
+    if(Tmr_is32Bit(handle)) return (TMR_REG_READ(Tmr_TimerMap[handle->number].iecReg->w) & Tmr_TimerMap[handle->number].intMask) > 0;
     
-    return (handle->descriptor->iecReg->w & handle->descriptor->intMask) > 0;
+    return (TMR_REG_READ(handle->descriptor->iecReg->w) & handle->descriptor->intMask) > 0;
 }
 
-uint32_t TMR_readIFS(TimerHandle_t * handle){
+uint32_t TMR_readIFS(TimerHandle_t * timer){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return 0;
+    
     //is the timer in 32Bit mode? If so the isr data comes from the slave timer
-    if(Tmr_is32Bit(handle)) return (Tmr_TimerMap[handle->number].ifsReg->w & Tmr_TimerMap[handle->number].intMask) > 0;
+    if(Tmr_is32Bit(handle)) return (TMR_REG_READ(Tmr_TimerMap[handle->number].ifsReg->w) & Tmr_TimerMap[handle->number].intMask) > 0;
     
-    return (handle->descriptor->ifsReg->w & handle->descriptor->intMask) > 0;
+    return (TMR_REG_READ(handle->descriptor->ifsReg->w) & handle->descriptor->intMask) > 0;
 }
 
-void TMR_clearIFS(TimerHandle_t * handle){
+void TMR_clearIFS(TimerHandle_t * timer){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return;
+    
     //in 32bit mode the bits from the slave timer need to be cleared
     if(Tmr_is32Bit(handle)){
-        Tmr_TimerMap[handle->number].ifsReg->CLR = handle->descriptor->intMask;
+        TMR_REG_WRITE(Tmr_TimerMap[handle->number].ifsReg->CLR, Tmr_TimerMap[handle->number].intMask);
     }else{
-        handle->descriptor->ifsReg->CLR = handle->descriptor->intMask;
+        TMR_REG_WRITE(handle->descriptor->ifsReg->CLR, handle->descriptor->intMask);
     }
 }
 
-void TMR_setInterruptPriority(TimerHandle_t * handle, uint32_t priority, uint32_t subPriority){
-    //we will have to perform a read-modify-write on the register to update the priority
-    //since this would take forever though we utilise the pics SET and CLR registers together with a mask
-    
-    //first we need to select the correct descriptor. If the timer is in 32bit mode all interrupt related settings come from the slave timer
-    TimerDescriptor_t * desc = Tmr_is32Bit(handle) ? &Tmr_TimerMap[handle->number] : handle->descriptor;
-    
-    //first we make sure the interrupt is off
-    uint32_t irqEnabled = TMR_isIRQEnabled(handle);
-    TMR_setIRQEnabled(handle, 0);
+//sets the interrupt flag by software, the isr then runs just like after a period match
+void TMR_triggerIRQ(TimerHandle_t * timer){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return;
     
-    //then we clear the priority bits. There are 5 (hence 0b11111) and located at the offset pointed to by ipcOffset
-    desc->ipcReg->CLR = 0b11111 << desc->ipcOffset;
+    const TimerDescriptor_t * desc = Tmr_is32Bit(handle) ? &Tmr_TimerMap[handle->number] : handle->descriptor;
+    TMR_REG_WRITE(desc->ifsReg->SET, desc->intMask);
+}
+
+void TMR_setInterruptPriority(TimerHandle_t * timer, uint32_t priority, uint32_t subPriority){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return;
     
-    //then we generate the new priority bits
+    //the priority bits are flipped with a single INV write based on the shadow, so there is no read-modify-write and no intermediate priority
+    //that means we also don't need to switch the interrupt off while we change it
     Pic32PrioBits_t map = {.priority = priority, .subPriority = subPriority};
-    
-    //after that we assign the shifted mask to the SET register to complete the operation
-    desc->ipcReg->SET = map.map << desc->ipcOffset;
-   
-    TMR_setIRQEnabled(handle, irqEnabled);
+    Tmr_commitPriority(handle, map.map);
 }
 
-void TMR_setClockSource(TimerHandle_t * handle, uint32_t source, uint32_t gate, uint32_t sync){
+void TMR_setClockSource(TimerHandle_t * timer, uint32_t source, uint32_t gate, uint32_t sync){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return;
+    
     //both timers behave the same way in this regard, with the exception of a type A timer, which also has the sync option.
     //On a type B timer this is just ignored though so we set it anyway TODO evaluate if thats the case
-    TMR_REGS.TCON.TCS = source;
-    TMR_REGS.TCON.TGATE = gate;
-    TMR_REGS.TCON.TSYNC = sync;
+    uint32_t tcon = 0;
+    if(source) tcon |= TMR_TCS_MASK;
+    if(gate) tcon |= TMR_TGATE_MASK;
+    if(sync) tcon |= TMR_TSYNC_MASK;
+    
+    Tmr_commitTCON(handle, TMR_TCS_MASK | TMR_TGATE_MASK | TMR_TSYNC_MASK, tcon);
 }
 
-void TMR_setPrescaler(TimerHandle_t * handle, uint32_t scaler){
+void TMR_setPrescaler(TimerHandle_t * timer, uint32_t scaler){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return;
+    
     //check what type of timer we're dealing with
-    if(handle->descriptor->type == TmrType_A){
-        TMR_REGS.TCON.TYPEA_TCKPS = scaler;
-    }else{
-        TMR_REGS.TCON.TYPEB_TCKPS = scaler;
-    }
+    uint32_t mask = (handle->descriptor->type == TmrType_A) ? TMR_TYPEA_TCKPS_MASK : TMR_TYPEB_TCKPS_MASK;
+    Tmr_commitTCON(handle, mask, scaler << TMR_TCKPS_POSITION);
 }
 
-uint32_t TMR_getCount(TimerHandle_t * handle){
-    return handle->descriptor->registerMap->TMR;
+void TMR_setPrescalerAndPR(TimerHandle_t * timer, uint32_t scaler, uint32_t prValue){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return;
+    
+    //raw values, a clock change can't know what they were meant to be
+    handle->request = TMR_REQUEST_NONE;
+    
+    //the prescaler bits are changed from the shadow, so this is one TCON write without a read
+    TMR_setPrescaler(timer, scaler);
+    TMR_setPR(timer, prValue);
 }
 
-uint32_t TMR_calculatePR(TimerHandle_t * handle, uint32_t period_us, uint32_t divider){
-    uint64_t effClock_Hz = (uint64_t) TMR_CLK_Hz >> (uint64_t) ((handle->descriptor->type == TmrType_A) ? typeBPrescalersShifts[divider] : typeBPrescalersShifts[divider]);
-    uint64_t pr = (uint64_t) (effClock_Hz * (uint64_t) period_us) / (uint64_t) 1000000;
+uint32_t TMR_getCount(TimerHandle_t * timer){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return 0;
+    
+    return TMR_REG_READ(handle->descriptor->registerMap->TMR);
+}
+
+uint32_t TMR_calculatePR(TimerHandle_t * timer, uint32_t period_us, uint32_t divider){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return 0;
+    
+    const uint32_t * shifts = (handle->descriptor->type == TmrType_A) ? typeAPrescalersShifts : typeBPrescalersShifts;
+    uint32_t shiftCount = (handle->descriptor->type == TmrType_A) ? arraySize(typeAPrescalersShifts) : arraySize(typeBPrescalersShifts);
+    if(divider >= shiftCount) return 0;
+    
+    uint64_t effClock_Hz = (uint64_t) Tmr_clock_Hz >> shifts[divider];
+    uint64_t pr = Tmr_divide(effClock_Hz * (uint64_t) period_us, 1000000);
     
     if(pr > (uint64_t) INT32_MAX){
         return 0;
@@ -324,31 +1069,54 @@ uint32_t TMR_calculatePR(TimerHandle_t * handle, uint32_t period_us, uint32_t di
     return (uint32_t) pr;
 }
 
-void TMR_setPR(TimerHandle_t * handle, uint32_t prValue){
+void TMR_setPR(TimerHandle_t * timer, uint32_t prValue){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return;
+    
     //write the value to the PR register. If the timer is in 32bit mode the hardware will automatically map the lower and upper bytes accordingly
-    handle->descriptor->registerMap->PR = prValue;
+    TMR_REG_WRITE(handle->descriptor->registerMap->PR, prValue);
     
     //reset the timer counter if the current count is larger than the period compare value
-    if(handle->descriptor->registerMap->TMR > prValue) handle->descriptor->registerMap->TMR = 0;
+    if(TMR_REG_READ(handle->descriptor->registerMap->TMR) > prValue) TMR_REG_WRITE(handle->descriptor->registerMap->TMR, 0);
 }
 
 //functions to get pointers to the timer counter and compare registers
-uint32_t * TMR_getPRPointer(TimerHandle_t * handle){
+uint32_t * TMR_getPRPointer(TimerHandle_t * timer){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return NULL;
+    
     return &(TMR_REGS.PR);
 }
 
-uint32_t * TMR_getTMRPointer(TimerHandle_t * handle){
+uint32_t * TMR_getTMRPointer(TimerHandle_t * timer){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return NULL;
+    
     return &(TMR_REGS.TMR);
 }
 
-uint32_t TMR_getInterruptNumber(TimerHandle_t * handle){
+void TMR_claimPR(TimerHandle_t * timer){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return;
+    
+    //without a request Tmr_rescale only keeps the count rate, the owner of PR decides what it counts to
+    handle->request = TMR_REQUEST_NONE;
+}
+
+uint32_t TMR_getInterruptNumber(TimerHandle_t * timer){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return 0;
+    
     //is the timer in 32Bit mode? If so the isr number is that of the slave timer (so number + 1)
     if(Tmr_is32Bit(handle)) return Tmr_TimerMap[handle->number].interruptNumber;
     
     return handle->descriptor->interruptNumber;
 }
 
-uint32_t TMR_getInterruptVector(TimerHandle_t * handle){
+uint32_t TMR_getInterruptVector(TimerHandle_t * timer){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return 0;
+    
     //is the timer in 32Bit mode? If so the isr number is that of the slave timer (so number + 1)
     if(Tmr_is32Bit(handle)) return Tmr_TimerMap[handle->number].interruptVector;
     
@@ -356,6 +1124,205 @@ uint32_t TMR_getInterruptVector(TimerHandle_t * handle){
 }
  
 
+#if TMR_ENABLE_ISR_STATS
+static void Tmr_statsRecord(TimerStat_t * stat, uint32_t value){
+    if(stat->count == 0 || value < stat->min) stat->min = value;
+    if(value > stat->max) stat->max = value;
+    stat->sum += value;
+    stat->count++;
+    
+    //power of two buckets, so finding the right one is just a count leading zeros
+    uint32_t bucket = (value == 0) ? 0 : 32 - __builtin_clz(value);
+    if(bucket >= TMR_STATS_BUCKETS) bucket = TMR_STATS_BUCKETS - 1;
+    stat->histogram[bucket]++;
+}
+
+uint32_t TMR_getIsrStats(TimerHandle_t * timer, TimerIsrStats_t * stats){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return 0;
+    
+    uint32_t index = Tmr_is32Bit(handle) ? handle->number : handle->number - 1;
+    
+    //copy with the interrupt off so we don't get a half updated set
+    uint32_t irqEnabled = TMR_isIRQEnabled(timer);
+    TMR_setIRQEnabled(timer, 0);
+    *stats = isrStats[index];
+    TMR_setIRQEnabled(timer, irqEnabled);
+    
+    stats->latency.mean = stats->latency.count ? (uint32_t) (stats->latency.sum / stats->latency.count) : 0;
+    stats->jitter.mean = stats->jitter.count ? (uint32_t) (stats->jitter.sum / stats->jitter.count) : 0;
+    stats->duration.mean = stats->duration.count ? (uint32_t) (stats->duration.sum / stats->duration.count) : 0;
+    
+    return pdPASS;
+}
+
+void TMR_resetIsrStats(TimerHandle_t * timer){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return;
+    
+    uint32_t index = Tmr_is32Bit(handle) ? handle->number : handle->number - 1;
+    
+    uint32_t irqEnabled = TMR_isIRQEnabled(timer);
+    TMR_setIRQEnabled(timer, 0);
+    memset(&isrStats[index], 0, sizeof(TimerIsrStats_t));
+    TMR_setIRQEnabled(timer, irqEnabled);
+}
+#endif
+
+#if TMR_PERIOD_QUEUE_SIZE > 0
+uint32_t TMR_queuePrescalerAndPR(TimerHandle_t * timer, uint32_t scaler, uint32_t prValue){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return 0;
+    
+    TimerPeriodQueue_t * queue = &periodQueues[Tmr_is32Bit(handle) ? handle->number : handle->number - 1];
+    
+    uint32_t head = queue->head;
+    if(head - queue->tail >= TMR_PERIOD_QUEUE_SIZE) return pdFAIL;
+    
+    queue->entries[head & (TMR_PERIOD_QUEUE_SIZE - 1)].prescaler = scaler;
+    queue->entries[head & (TMR_PERIOD_QUEUE_SIZE - 1)].prValue = prValue;
+    
+    //the entry must be complete before the isr can see it
+    __sync_synchronize();
+    queue->head = head + 1;
+    
+    return pdPASS;
+}
+
+uint32_t TMR_queueFrequency(TimerHandle_t * timer, uint32_t Frequency_mHz){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return 0;
+    
+    TmrRateSolution_t solution;
+    if(!TMR_findClosestRate(handle->descriptor->type, Tmr_is32Bit(handle), Frequency_mHz, &solution)) return pdFAIL;
+    
+    return TMR_queuePrescalerAndPR(timer, solution.prescaler, solution.prValue);
+}
+
+uint32_t TMR_getQueuedUpdateCount(TimerHandle_t * timer){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return 0;
+    
+    TimerPeriodQueue_t * queue = &periodQueues[Tmr_is32Bit(handle) ? handle->number : handle->number - 1];
+    return queue->head - queue->tail;
+}
+
+void TMR_flushPeriodQueue(TimerHandle_t * timer){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return;
+    
+    TimerPeriodQueue_t * queue = &periodQueues[Tmr_is32Bit(handle) ? handle->number : handle->number - 1];
+    
+    //tail belongs to the isr, so keep it from running while we move it
+    uint32_t irqEnabled = TMR_isIRQEnabled(timer);
+    TMR_setIRQEnabled(timer, 0);
+    queue->tail = queue->head;
+    TMR_setIRQEnabled(timer, irqEnabled);
+}
+#endif
+
+#if TMR_ENABLE_SEQUENCER
+//hands PR back to the driver once a sequence is over, unless a period or frequency was set while it ran
+static void Tmr_endSequence(TimerState_t * handle, uint32_t index){
+    sequences[index].length = 0;
+    if(handle->request != TMR_REQUEST_NONE) return;
+    
+    handle->requestValue = sequenceRequestValues[index];
+    handle->request = sequenceRequests[index];
+}
+
+uint32_t TMR_startSequence(TimerHandle_t * timer, const TimerSequence_t * sequence){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return 0;
+    
+    if(sequence->prValues == NULL || sequence->length == 0) return pdFAIL;
+    
+    uint32_t index = Tmr_is32Bit(handle) ? handle->number : handle->number - 1;
+    
+    //the isr must not see a half copied sequence
+    TMR_setIRQEnabled(timer, 0);
+    TMR_setEnabled(timer, 0);
+    
+    //the isr writes PR from now on, a clock change must leave it alone. A sequence replacing another one keeps the request from before the first
+    if(sequences[index].length == 0){
+        sequenceRequests[index] = handle->request;
+        sequenceRequestValues[index] = handle->requestValue;
+    }
+    TMR_claimPR(timer);
+    
+    sequences[index] = *sequence;
+    sequencePositions[index] = 0;
+    
+    //the first step runs right away, the isr loads the following ones at every match
+    TMR_REG_WRITE(TMR_REGS.TMR, 0);
+    TMR_REG_WRITE(TMR_REGS.PR, sequence->prValues[0]);
+    TMR_clearIFS(timer);
+    
+    TMR_setIRQEnabled(timer, 1);
+    TMR_setEnabled(timer, 1);
+    
+    return pdPASS;
+}
+
+void TMR_stopSequence(TimerHandle_t * timer){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return;
+    
+    uint32_t index = Tmr_is32Bit(handle) ? handle->number : handle->number - 1;
+    
+    //the timer keeps running with whatever period the sequence was at
+    uint32_t irqEnabled = TMR_isIRQEnabled(timer);
+    TMR_setIRQEnabled(timer, 0);
+    if(sequences[index].length != 0) Tmr_endSequence(handle, index);
+    TMR_setIRQEnabled(timer, irqEnabled);
+}
+
+uint32_t TMR_isSequenceRunning(TimerHandle_t * timer){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return 0;
+    
+    return sequences[Tmr_is32Bit(handle) ? handle->number : handle->number - 1].length != 0;
+}
+
+uint32_t TMR_getSequencePosition(TimerHandle_t * timer){
+    TimerState_t * handle = Tmr_resolve(timer);
+    if(handle == NULL) return 0;
+    
+    return sequencePositions[Tmr_is32Bit(handle) ? handle->number : handle->number - 1];
+}
+
+//advances the sequence of a timer by one step. Called from the isr at every period match
+static inline void Tmr_sequenceStep(TimerState_t * handle, uint32_t timerIndex){
+    TimerSequence_t * sequence = &sequences[timerIndex];
+    
+    //the step that just ended
+    uint32_t position = sequencePositions[timerIndex];
+    if(sequence->stepCallbacks != NULL && sequence->stepCallbacks[position] != NULL) (*sequence->stepCallbacks[position])(handle->self, TMR_SEQ_FLAG_STEP, sequence->data);
+    
+    position++;
+    
+    //the first half is done and can be refilled
+    if(position == (sequence->length >> 1) && sequence->notify != NULL) (*sequence->notify)(handle->self, TMR_SEQ_FLAG_HALF, sequence->data);
+    
+    if(position == sequence->length){
+        //the second half is done too
+        if(sequence->notify != NULL) (*sequence->notify)(handle->self, TMR_SEQ_FLAG_COMPLETE, sequence->data);
+        
+        if(sequence->mode == TmrSeqMode_OneShot){
+            //the last period just ended, stop on the edge
+            TMR_setEnabled(handle->self, 0);
+            Tmr_endSequence(handle, timerIndex);
+            return;
+        }
+        
+        position = 0;
+    }
+    
+    TMR_setPR(handle->self, sequence->prValues[position]);
+    sequencePositions[timerIndex] = position;
+}
+#endif
+
 //function that gets called when an isr occurs. timerIndex is the timerNumber but already decremented by 1 (so the timer array index)
 void TMR_isrHandler(uint32_t timerIndex){
     //a timer irq just occurred, check what we need to do to handle it
@@ -370,17 +1337,74 @@ void TMR_isrHandler(uint32_t timerIndex){
     }
     
     //first get the handle
-    TimerHandle_t * handle = isr->handle;
+    TimerState_t * handle = isr->handle;
     
     //is the timer in single shot mode? If so we should disable it now
     if(handle->currentMode == TmrMode_SingleShot){
-        TMR_setIRQEnabled(handle, 0);
+        TMR_setIRQEnabled(handle->self, 0);
     }
     
+#if TMR_ENABLE_ISR_STATS
+    //the entry count was taken with the prescaler of the period that just ended, get it before the queue or the sequencer change it
+    uint32_t entryShift = Tmr_getPrescalerShift(handle);
+#endif
+    
+#if TMR_PERIOD_QUEUE_SIZE > 0
+    //the period that just ended was the last one with the old settings. The counter only just restarted so changing PR now doesn't cut anything short
+    TimerPeriodQueue_t * queue = &periodQueues[timerIndex];
+    if(queue->tail != queue->head){
+        //pairs with the barrier in TMR_queuePrescalerAndPR, the entry is only read after head said it is complete
+        __sync_synchronize();
+        uint32_t tail = queue->tail;
+        TMR_setPrescaler(handle->self, queue->entries[tail & (TMR_PERIOD_QUEUE_SIZE - 1)].prescaler);
+        TMR_setPR(handle->self, queue->entries[tail & (TMR_PERIOD_QUEUE_SIZE - 1)].prValue);
+        queue->tail = tail + 1;
+    }
+#endif
+    
+#if TMR_ENABLE_SEQUENCER
+    //a running sequence overrides any queued period updates
+    if(sequences[timerIndex].length != 0) Tmr_sequenceStep(handle, timerIndex);
+#endif
+    
+#if TMR_ENABLE_ISR_STATS
+    //the counter restarted from 0 on the period match, so its value on entry is the latency in timer clocks
+    TimerIsrStats_t * stats = &isrStats[timerIndex];
+    uint32_t latency = Tmr_isrEntryCount[timerIndex] << entryShift;
+    
+    if(stats->latency.count > 0) Tmr_statsRecord(&stats->jitter, (latency > stats->lastLatency) ? latency - stats->lastLatency : stats->lastLatency - latency);
+    Tmr_statsRecord(&stats->latency, latency);
+    stats->lastLatency = latency;
+    
+    //prescaler and PR the callback runs with, any queued update is in by now. The callback itself may change them again, so they are taken before it runs
+    uint32_t shift = Tmr_getPrescalerShift(handle);
+    uint32_t pr = TMR_REG_READ(TMR_REGS.PR);
+    
+    //not traced, with tracing on this would only measure the trace itself
+    uint32_t callbackStart = TMR_REGS.TMR;
+#endif
+    
+    //take a consistent copy of the binding. If a rebind from a higher priority interrupt came in while we read it just read it again.
+    //The barriers pair with the one in Tmr_publishISR and keep the copy between the two reads of sequence
+    TimerIsrBinding_t binding;
+    uint32_t sequence;
+    do{
+        sequence = isr->sequence;
+        __sync_synchronize();
+        binding = isr->bindings[sequence & 1];
+        __sync_synchronize();
+    }while(sequence != isr->sequence);
+    
     //is an isr assigned to this timer?
-    if(isr->function != NULL){
+    if(binding.function != NULL){
         //yes! call it
-        (*isr->function)(handle, 0, isr->data);
+        (*binding.function)(handle->self, 0, binding.data);
     }
     
+#if TMR_ENABLE_ISR_STATS
+    //the counter might have wrapped at PR while the callback ran
+    uint32_t callbackEnd = TMR_REGS.TMR;
+    uint32_t duration = (callbackEnd >= callbackStart) ? callbackEnd - callbackStart : callbackEnd + (pr - callbackStart) + 1;
+    Tmr_statsRecord(&stats->duration, duration << shift);
+#endif
 }
\ No newline at end of file
@@ -25,6 +25,7 @@ const TimerDescriptor_t Tmr_TimerMap[TMR_NUM_TIMERS] =
 
 #if defined(T1CON) && (configTICK_INTERRUPT_VECTOR != _TIMER_1_VECTOR)
    void __ISR(_TIMER_1_VECTOR) T1ISR(){ 
+      TMR_ISR_ENTRY(0);
       IFS0CLR = _IFS0_T1IF_MASK;
       TMR_isrHandler(0);
    } 
@@ -32,6 +33,7 @@ const TimerDescriptor_t Tmr_TimerMap[TMR_NUM_TIMERS] =
  
 #if defined(T2CON) && configTICK_INTERRUPT_VECTOR != _TIMER_2_VECTOR
    void __ISR(_TIMER_2_VECTOR) T2ISR(){ 
+      TMR_ISR_ENTRY(1);
       IFS0CLR = _IFS0_T2IF_MASK;
       TMR_isrHandler(1);
    } 
@@ -39,6 +41,7 @@ const TimerDescriptor_t Tmr_TimerMap[TMR_NUM_TIMERS] =
  
 #if defined(T3CON) && configTICK_INTERRUPT_VECTOR != _TIMER_3_VECTOR
    void __ISR(_TIMER_3_VECTOR) T3ISR(){ 
+      TMR_ISR_ENTRY(2);
       IFS0CLR = _IFS0_T3IF_MASK;
       TMR_isrHandler(2);
    } 
@@ -46,6 +49,7 @@ const TimerDescriptor_t Tmr_TimerMap[TMR_NUM_TIMERS] =
  
 #if defined(T4CON) && configTICK_INTERRUPT_VECTOR != _TIMER_4_VECTOR
    void __ISR(_TIMER_4_VECTOR) T4ISR(){ 
+      TMR_ISR_ENTRY(3);
       IFS0CLR = _IFS0_T4IF_MASK;
       TMR_isrHandler(3);
    } 
@@ -53,6 +57,7 @@ const TimerDescriptor_t Tmr_TimerMap[TMR_NUM_TIMERS] =
  
 #if defined(T5CON) && configTICK_INTERRUPT_VECTOR != _TIMER_5_VECTOR
    void __ISR(_TIMER_5_VECTOR) T5ISR(){ 
+      TMR_ISR_ENTRY(4);
       IFS0CLR = _IFS0_T5IF_MASK;
       TMR_isrHandler(4);
    } 
@@ -60,6 +65,7 @@ const TimerDescriptor_t Tmr_TimerMap[TMR_NUM_TIMERS] =
  
 #if defined(T6CON) && configTICK_INTERRUPT_VECTOR != _TIMER_6_VECTOR
    void __ISR(_TIMER_6_VECTOR) T6ISR(){ 
+      TMR_ISR_ENTRY(5);
       IFS0CLR = _IFS0_T6IF_MASK;
       TMR_isrHandler(5);
    } 
@@ -67,6 +73,7 @@ const TimerDescriptor_t Tmr_TimerMap[TMR_NUM_TIMERS] =
  
 #if defined(T7CON) && configTICK_INTERRUPT_VECTOR != _TIMER_7_VECTOR
    void __ISR(_TIMER_7_VECTOR) T7ISR(){ 
+      TMR_ISR_ENTRY(6);
       IFS0CLR = _IFS0_T7IF_MASK;
       TMR_isrHandler(6);
    } 
@@ -74,6 +81,7 @@ const TimerDescriptor_t Tmr_TimerMap[TMR_NUM_TIMERS] =
  
 #if defined(T8CON) && configTICK_INTERRUPT_VECTOR != _TIMER_8_VECTOR
    void __ISR(_TIMER_8_VECTOR) T8ISR(){ 
+      TMR_ISR_ENTRY(7);
       IFS0CLR = _IFS0_T8IF_MASK;
       TMR_isrHandler(7);
    } 
@@ -81,6 +89,7 @@ const TimerDescriptor_t Tmr_TimerMap[TMR_NUM_TIMERS] =
  
 #if defined(T9CON) && configTICK_INTERRUPT_VECTOR != _TIMER_9_VECTOR
    void __ISR(_TIMER_9_VECTOR) T9ISR(){ 
+      TMR_ISR_ENTRY(8);
       IFS0CLR = _IFS0_T9IF_MASK;
       TMR_isrHandler(8);
    } 
@@ -88,6 +97,7 @@ const TimerDescriptor_t Tmr_TimerMap[TMR_NUM_TIMERS] =
  
 #if defined(T10CON) && configTICK_INTERRUPT_VECTOR != _TIMER_10_VECTOR
    void __ISR(_TIMER_10_VECTOR) T10ISR(){ 
+      TMR_ISR_ENTRY(9);
       IFS0CLR = _IFS0_T10IF_MASK;
       TMR_isrHandler(9);
    } 
@@ -95,6 +105,7 @@ const TimerDescriptor_t Tmr_TimerMap[TMR_NUM_TIMERS] =
  
 #if defined(T11CON) && configTICK_INTERRUPT_VECTOR != _TIMER_11_VECTOR
    void __ISR(_TIMER_11_VECTOR) T11ISR(){ 
+      TMR_ISR_ENTRY(10);
       IFS0CLR = _IFS0_T11IF_MASK;
       TMR_isrHandler(10);
    } 
@@ -102,6 +113,7 @@ const TimerDescriptor_t Tmr_TimerMap[TMR_NUM_TIMERS] =
  
 #if defined(T12CON) && configTICK_INTERRUPT_VECTOR != _TIMER_12_VECTOR
    void __ISR(_TIMER_12_VECTOR) T12ISR(){ 
+      TMR_ISR_ENTRY(11);
       IFS0CLR = _IFS0_T12IF_MASK;
       TMR_isrHandler(11);
    } 
@@ -0,0 +1,324 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef TMR_SIMULATION
+#include <xc.h>
+
+#if !__is_compiling || __has_include("FreeRTOS.h")
+#include "FreeRTOS.h"
+#endif
+#endif
+
+#include "Timer.h"
+#include "TimerConfig.h"
+#include "TimerDeadline.h"
+
+//min-heap of pending deadlines, the earliest one is always at index 0
+static TimerDeadline_t * heap[TDL_MAX_DEADLINES];
+static uint32_t heapCount = 0;
+
+//time of the last period match. The current time is base + TMR
+static volatile uint64_t base = 0;
+
+//set when the interrupt was triggered by software instead of a period match. TMR didn't reset in that case so base must not advance
+static volatile uint32_t softwareTrigger = 0;
+
+//set while the interrupt walks the queue, so deadlines added from callbacks don't reprogram the timer in the middle of it
+static uint32_t inIsr = 0;
+
+//tick the timer was last programmed to match at, UINT64_MAX if no deadline is pending
+static uint64_t nextMatch = UINT64_MAX;
+
+//PR of the period that is running now, the isr advances base by this + 1. Kept apart from PR itself, which may already hold the value for the next period
+static volatile uint32_t periodPR = 0xffffffff;
+
+static TimerDeadlineStats_t stats;
+
+static TimerHandle_t * dlHandle = NULL;
+static volatile uint32_t * prReg = NULL;
+static volatile uint32_t * tmrReg = NULL;
+
+static void TDL_swap(uint32_t a, uint32_t b){
+    TimerDeadline_t * tmp = heap[a];
+    heap[a] = heap[b];
+    heap[b] = tmp;
+
+    heap[a]->heapIndex = a;
+    heap[b]->heapIndex = b;
+}
+
+static void TDL_siftUp(uint32_t index){
+    while(index > 0){
+        uint32_t parent = (index - 1) / 2;
+        if(heap[parent]->deadline <= heap[index]->deadline) break;
+
+        TDL_swap(parent, index);
+        index = parent;
+    }
+}
+
+static void TDL_siftDown(uint32_t index){
+    while(1){
+        uint32_t smallest = index;
+        uint32_t left = index * 2 + 1;
+        uint32_t right = left + 1;
+
+        if(left < heapCount && heap[left]->deadline < heap[smallest]->deadline) smallest = left;
+        if(right < heapCount && heap[right]->deadline < heap[smallest]->deadline) smallest = right;
+        if(smallest == index) break;
+
+        TDL_swap(smallest, index);
+        index = smallest;
+    }
+}
+
+static void TDL_remove(TimerDeadline_t * deadline){
+    uint32_t index = deadline->heapIndex;
+    deadline->heapIndex = TDL_NOT_QUEUED;
+
+    //move the last element into the gap and restore the heap order around it
+    heapCount--;
+    if(index == heapCount) return;
+
+    heap[index] = heap[heapCount];
+    heap[index]->heapIndex = index;
+    TDL_siftUp(index);
+    TDL_siftDown(heap[index]->heapIndex);
+}
+
+//finds the earliest latest allowed expiry (deadline + slack) of all pending deadlines. Children in the heap are never due before their parent,
+//so any subtree whose root isn't due before the best time found so far can be skipped
+static void TDL_findMatch(uint32_t index, uint64_t * best){
+    if(index >= heapCount || heap[index]->deadline >= *best) return;
+
+    uint64_t latest = heap[index]->deadline + heap[index]->slack;
+    if(latest < *best) *best = latest;
+
+    TDL_findMatch(index * 2 + 1, best);
+    TDL_findMatch(index * 2 + 2, best);
+}
+
+//programs PR to match at the last moment the most urgent deadline allows. Everything that is due by then is handled in the same interrupt.
+//Must be called with the timer interrupt disabled
+static void TDL_reprogram(){
+    uint32_t tmr = *tmrReg;
+    uint32_t oldPR = *prReg;
+
+    //is an interrupt already pending? If so base is stale and the isr will reprogram the timer anyway. Checked after reading TMR, so a match in
+    //between can't leave us with a count from the previous period
+    if(TMR_readIFS(dlHandle)) return;
+
+    //is the current match about to happen? Then we might not be able to change PR in time, let the isr handle it instead
+    if(oldPR >= tmr && (oldPR - tmr) < TDL_MIN_LEAD_TICKS) return;
+
+    //without any deadlines the timer just runs to the end, that keeps the 64bit time base going with one interrupt every 2^32 ticks
+    uint32_t pr = 0xffffffff;
+    nextMatch = UINT64_MAX;
+    if(heapCount > 0){
+        TDL_findMatch(0, &nextMatch);
+        uint64_t matchTick = nextMatch - base;
+
+        //PR + 1 ticks after the last match the counter matches. Deadlines closer than the minimum lead (or already late) get that lead instead.
+        //Close to the end of the range the lead would wrap PR below the counter, the match at the end of the range comes soon enough then
+        if(nextMatch < base + (uint64_t) tmr + TDL_MIN_LEAD_TICKS){
+            if(tmr < 0xffffffff - TDL_MIN_LEAD_TICKS) pr = tmr + TDL_MIN_LEAD_TICKS;
+        }else if(matchTick - 1 < 0xffffffff){
+            pr = (uint32_t) (matchTick - 1);
+        }
+    }
+
+    //write PR directly, TMR_setPR would reset the counter if it ran past the value and that would corrupt the time base
+    *prReg = pr;
+
+    //did the old match still come in before the write landed? The minimum lead keeps the new one out of reach that quickly, so the period that ended
+    //was the old one. periodPR stays at that for the isr, which takes the new value from PR and reprograms anyway
+    if(TMR_readIFS(dlHandle)) return;
+    periodPR = pr;
+
+    //late reprogram race: did the counter run past the new value before the write landed? Then it would only match after a full wrap, so trigger the interrupt by software
+    if(heapCount > 0 && *tmrReg > pr){
+        softwareTrigger = 1;
+        TMR_triggerIRQ(dlHandle);
+    }
+}
+
+static uint32_t TDL_isr(TimerHandle_t * handle, uint32_t flags, void * data){
+    //advance the time base by the period that just ended. The next one runs with whatever is in PR now
+    if(softwareTrigger){
+        softwareTrigger = 0;
+    }else{
+        base += (uint64_t) periodPR + 1;
+        periodPR = *prReg;
+    }
+
+    //call everything that is due, including deadlines that became due while the callbacks ran
+    inIsr = 1;
+    uint32_t expired = 0;
+    while(heapCount > 0){
+        TimerDeadline_t * deadline = heap[0];
+        if(deadline->deadline > base + *tmrReg) break;
+
+        TDL_remove(deadline);
+        expired++;
+        if(deadline->callback != NULL) deadline->callback(deadline, deadline->data);
+    }
+    inIsr = 0;
+
+    //every expiry after the first one would have needed an interrupt of its own
+    stats.interrupts++;
+    stats.expiries += expired;
+    if(expired > 1) stats.coalesced += expired - 1;
+
+    TDL_reprogram();
+
+    //single shot mode switched the interrupt off before calling us, we always need it to keep the time base going
+    TMR_setIRQEnabled(handle, 1);
+
+    return 0;
+}
+
+uint32_t TDL_init(TimerHandle_t * handle){
+    TimerState_t * state = TMR_getState(handle);
+    if(state == NULL || dlHandle != NULL || !(state->flags & TMR_FLAG_32BIT_MODE)) return pdFAIL;
+
+    if(!TMR_setISR(handle, TDL_isr, NULL)) return pdFAIL;
+
+    dlHandle = handle;
+    prReg = TMR_getPRPointer(handle);
+    TMR_claimPR(handle);
+    tmrReg = TMR_getTMRPointer(handle);
+
+    heapCount = 0;
+    base = 0;
+    softwareTrigger = 0;
+    nextMatch = UINT64_MAX;
+    periodPR = 0xffffffff;
+    TDL_resetStats();
+
+    //start with an empty queue, the counter runs the full 32bit range
+    TMR_setEnabled(handle, 0);
+    *tmrReg = 0;
+    *prReg = 0xffffffff;
+    TMR_clearIFS(handle);
+
+    TMR_setMode(handle, TmrMode_SingleShot);
+    TMR_setIRQEnabled(handle, 1);
+    TMR_setEnabled(handle, 1);
+
+    return pdPASS;
+}
+
+void TDL_deinit(){
+    if(dlHandle == NULL) return;
+
+    TMR_setIRQEnabled(dlHandle, 0);
+    TMR_setISR(dlHandle, NULL, NULL);
+
+    for(uint32_t i = 0; i < heapCount; i++) heap[i]->heapIndex = TDL_NOT_QUEUED;
+    heapCount = 0;
+
+    dlHandle = NULL;
+    prReg = NULL;
+    tmrReg = NULL;
+}
+
+void TDL_initDeadline(TimerDeadline_t * deadline, TimerDeadlineCallback_t callback, void * data){
+    deadline->deadline = 0;
+    deadline->slack = 0;
+    deadline->heapIndex = TDL_NOT_QUEUED;
+    deadline->callback = callback;
+    deadline->data = data;
+}
+
+uint64_t TDL_now(){
+    if(dlHandle == NULL) return 0;
+
+    uint32_t irqEnabled = TMR_isIRQEnabled(dlHandle);
+    TMR_setIRQEnabled(dlHandle, 0);
+
+    //read the counter between two looks at the flag, so it is known which side of a match it came from
+    uint32_t pending;
+    uint32_t tmr;
+    do{
+        pending = TMR_readIFS(dlHandle);
+        tmr = *tmrReg;
+    }while(pending != TMR_readIFS(dlHandle));
+
+    uint64_t now = base + tmr;
+
+    //did the period end but the isr didn't get to run yet? Then base is missing the last period and TMR already restarted from 0
+    if(pending && !softwareTrigger) now += (uint64_t) periodPR + 1;
+
+    TMR_setIRQEnabled(dlHandle, irqEnabled);
+    return now;
+}
+
+uint32_t TDL_add(TimerDeadline_t * deadline, uint64_t ticks){
+    if(dlHandle == NULL) return pdFAIL;
+
+    uint32_t irqEnabled = TMR_isIRQEnabled(dlHandle);
+    TMR_setIRQEnabled(dlHandle, 0);
+
+    //re-queue if its already pending
+    if(deadline->heapIndex != TDL_NOT_QUEUED) TDL_remove(deadline);
+
+    if(heapCount >= TDL_MAX_DEADLINES){
+        TMR_setIRQEnabled(dlHandle, irqEnabled);
+        return pdFAIL;
+    }
+
+    deadline->deadline = ticks;
+    deadline->heapIndex = heapCount;
+    heap[heapCount++] = deadline;
+    TDL_siftUp(deadline->heapIndex);
+
+    //only reprogram if the new deadline can't wait for the programmed match, the isr does it anyway once its done
+    if(!inIsr && ticks + deadline->slack < nextMatch) TDL_reprogram();
+
+    TMR_setIRQEnabled(dlHandle, irqEnabled);
+    return pdPASS;
+}
+
+uint32_t TDL_addIn(TimerDeadline_t * deadline, uint64_t delay_ticks){
+    return TDL_add(deadline, TDL_now() + delay_ticks);
+}
+
+void TDL_cancel(TimerDeadline_t * deadline){
+    //TDL_deinit already took everything off the queue
+    if(dlHandle == NULL) return;
+
+    uint32_t irqEnabled = TMR_isIRQEnabled(dlHandle);
+    TMR_setIRQEnabled(dlHandle, 0);
+
+    //the timer stays programmed to the old deadline, the isr will find nothing due and move on to the next one
+    if(deadline->heapIndex != TDL_NOT_QUEUED) TDL_remove(deadline);
+
+    TMR_setIRQEnabled(dlHandle, irqEnabled);
+}
+
+uint32_t TDL_isPending(TimerDeadline_t * deadline){
+    return deadline->heapIndex != TDL_NOT_QUEUED;
+}
+
+void TDL_setSlack(TimerDeadline_t * deadline, uint32_t slack_ticks){
+    //takes effect the next time the deadline is added
+    deadline->slack = slack_ticks;
+}
+
+void TDL_getStats(TimerDeadlineStats_t * ret){
+    if(dlHandle == NULL){
+        *ret = stats;
+        return;
+    }
+
+    uint32_t irqEnabled = TMR_isIRQEnabled(dlHandle);
+    TMR_setIRQEnabled(dlHandle, 0);
+    *ret = stats;
+    TMR_setIRQEnabled(dlHandle, irqEnabled);
+}
+
+void TDL_resetStats(){
+    stats.interrupts = 0;
+    stats.expiries = 0;
+    stats.coalesced = 0;
+}
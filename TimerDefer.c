@@ -0,0 +1,143 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef TMR_SIMULATION
+#include <xc.h>
+
+#if !__is_compiling || __has_include("FreeRTOS.h")
+#include "FreeRTOS.h"
+#include "task.h"
+#endif
+#endif
+
+#include "Timer.h"
+#include "TimerConfig.h"
+#include "TimerDefer.h"
+
+#if TDEF_RING_SIZE & (TDEF_RING_SIZE - 1)
+    #error "TDEF_RING_SIZE must be a power of two"
+#endif
+
+//one interrupt priority level for every possible value of the 3 priority bits
+#define TDEF_NUM_LEVELS 8
+
+typedef struct{
+    TimerDeferred_t * deferred;
+    uint32_t timestamp;
+} TimerDeferEvent_t;
+
+//head is only written by the interrupts of the level, tail only by the worker
+typedef struct{
+    TimerDeferEvent_t events[TDEF_RING_SIZE];
+    volatile uint32_t head;
+    volatile uint32_t tail;
+} TimerDeferRing_t;
+
+static TimerDeferRing_t rings[TDEF_NUM_LEVELS];
+
+#ifndef TMR_SIMULATION
+static TaskHandle_t workerTask = NULL;
+#endif
+
+static uint32_t TDEF_isr(TimerHandle_t * handle, uint32_t flags, void * data){
+    TimerDeferred_t * deferred = data;
+    TimerDeferRing_t * ring = &rings[deferred->level];
+    
+    uint32_t head = ring->head;
+    if(head - ring->tail >= TDEF_RING_SIZE){
+        deferred->dropped++;
+        return 0;
+    }
+    
+    ring->events[head & (TDEF_RING_SIZE - 1)].deferred = deferred;
+    ring->events[head & (TDEF_RING_SIZE - 1)].timestamp = TDEF_TIMESTAMP();
+    
+    //the event must be complete before the worker can see it
+    __sync_synchronize();
+    ring->head = head + 1;
+    
+#ifndef TMR_SIMULATION
+    //without a worker (TDEF_init not called yet) the event just waits in the ring, the first notification after the worker exists drains it too
+    if(workerTask == NULL) return 0;
+    
+    //this only counts up the notification value, the actual switch happens once after all pending interrupts are done
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(workerTask, &woken);
+    portEND_SWITCHING_ISR(woken);
+#endif
+    
+    return 0;
+}
+
+uint32_t TDEF_process(){
+    uint32_t count = 0;
+    
+    //drain the most urgent events first
+    for(int32_t level = TDEF_NUM_LEVELS - 1; level >= 0; level--){
+        TimerDeferRing_t * ring = &rings[level];
+        
+        //take the whole batch that is there right now, anything arriving in the meantime is picked up by the next notification
+        uint32_t head = ring->head;
+        uint32_t tail = ring->tail;
+        
+        //pairs with the barrier in TDEF_isr, the events up to head are only read after head said they are complete
+        __sync_synchronize();
+        
+        while(tail != head){
+            TimerDeferEvent_t * event = &ring->events[tail & (TDEF_RING_SIZE - 1)];
+            TimerDeferred_t * deferred = event->deferred;
+            uint32_t timestamp = event->timestamp;
+            
+            //free the slot before running the callback so the interrupt can reuse it while that takes its time. The copy must be done by then
+            __sync_synchronize();
+            tail++;
+            ring->tail = tail;
+            count++;
+            
+            if(deferred->callback != NULL) (*deferred->callback)(deferred->handle, timestamp, deferred->data);
+        }
+    }
+    
+    return count;
+}
+
+#ifndef TMR_SIMULATION
+static void TDEF_task(void * params){
+    while(1){
+        //clear the notification count, a burst of events only wakes us once
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        TDEF_process();
+    }
+}
+
+uint32_t TDEF_init(uint32_t taskPriority){
+    if(workerTask != NULL) return pdFAIL;
+    
+    return xTaskCreate(TDEF_task, "TmrDefer", TDEF_TASK_STACK_SIZE, NULL, taskPriority, &workerTask);
+}
+#endif
+
+uint32_t TDEF_attach(TimerDeferred_t * deferred, TimerHandle_t * handle, TimerDeferredCallback_t callback, void * data){
+    TimerState_t * state = TMR_getState(handle);
+    if(deferred == NULL || state == NULL) return pdFAIL;
+    
+    deferred->handle = handle;
+    deferred->callback = callback;
+    deferred->data = data;
+    deferred->dropped = 0;
+    
+    //the upper 3 bits of the shadow are the interrupt priority, the lower 2 the sub priority
+    deferred->level = (state->priorityShadow >> 2) & (TDEF_NUM_LEVELS - 1);
+    
+    return TMR_setISR(handle, TDEF_isr, deferred);
+}
+
+void TDEF_detach(TimerDeferred_t * deferred){
+    if(deferred->handle == NULL) return;
+    
+    TMR_setISR(deferred->handle, NULL, NULL);
+    
+    //events already in a ring still point to the binding, so make sure they don't do anything anymore
+    deferred->callback = NULL;
+    deferred->handle = NULL;
+}
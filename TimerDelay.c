@@ -0,0 +1,206 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef TMR_SIMULATION
+#include <xc.h>
+
+#if !__is_compiling || __has_include("FreeRTOS.h")
+#include "FreeRTOS.h"
+#include "task.h"
+#endif
+#endif
+
+#include "Timer.h"
+#include "TimerConfig.h"
+#include "TimerDelay.h"
+
+//number of measurements the calibration takes the minimum of
+#define TDLY_CALIBRATION_RUNS 8
+
+//fixed point factor to convert a time into counter ticks: ticks = (time * mult) >> shift
+typedef struct{
+    uint32_t mult;
+    uint32_t shift;
+} DelayFactor_t;
+
+static TimerHandle_t * delayHandle = NULL;
+static volatile uint32_t * tmrReg = NULL;
+
+//all counter differences are masked to the counter width, which makes them correct across a wrap
+static uint32_t counterMask = 0;
+
+static uint32_t overhead = 0;
+static uint32_t yieldThreshold = 0;
+
+#ifndef TMR_SIMULATION
+static uint32_t ticksPerRtosTick = 0;
+
+//longest single vTaskDelay that can't hide a counter wrap from us, 0 if the counter is too short to sleep at all
+static uint32_t maxSleepTicks = 0;
+#endif
+
+static DelayFactor_t nsFactor;
+static DelayFactor_t usFactor;
+
+//same as in TimerTimestamp.c, just the other way around
+static void TDLY_makeFactor(DelayFactor_t * factor, uint32_t tickFrequency_Hz, uint32_t unitsPerSecond){
+    for(uint32_t shift = 32; shift > 0; shift--){
+        uint64_t mult = (((uint64_t) tickFrequency_Hz << shift) + (unitsPerSecond >> 1)) / unitsPerSecond;
+        if(mult <= 0xffffffff){
+            factor->mult = (uint32_t) mult;
+            factor->shift = shift;
+            return;
+        }
+    }
+    
+    factor->mult = 0xffffffff;
+    factor->shift = 0;
+}
+
+static inline uint32_t TDLY_convert(uint32_t time, DelayFactor_t * factor){
+    return ((uint64_t) time * factor->mult) >> factor->shift;
+}
+
+//waits until ticks have passed since start. The masked differences are added up on every pass, so the wait may be longer than one counter period
+static void TDLY_wait(uint32_t start, uint32_t ticks){
+    //compensate the time it took to get here
+    if(ticks <= overhead) return;
+    uint32_t remaining = ticks - overhead;
+    uint32_t last = start;
+    
+#ifndef TMR_SIMULATION
+    //long delays sleep for all full rtos ticks that fit in, vTaskDelay(n) can return up to one tick early so keep one in reserve.
+    //Every sleep is shorter than half a counter period, so the difference after it still tells how long it really was
+    if(remaining >= yieldThreshold && maxSleepTicks != 0 && xTaskGetSchedulerState() == taskSCHEDULER_RUNNING){
+        uint32_t rtosTicks = remaining / ticksPerRtosTick;
+        while(rtosTicks > 1){
+            vTaskDelay((rtosTicks - 1 > maxSleepTicks) ? maxSleepTicks : rtosTicks - 1);
+            
+            uint32_t now = *tmrReg;
+            uint32_t elapsed = (now - last) & counterMask;
+            if(elapsed >= remaining) return;
+            remaining -= elapsed;
+            last = now;
+            
+            rtosTicks = remaining / ticksPerRtosTick;
+        }
+    }
+#endif
+    
+    while(1){
+        uint32_t now = *tmrReg;
+        uint32_t elapsed = (now - last) & counterMask;
+        if(elapsed >= remaining) return;
+        remaining -= elapsed;
+        last = now;
+        
+        TDLY_SPIN();
+    }
+}
+
+//everything that depends on the count rate of the timer
+static void TDLY_updateRates(){
+    uint32_t tickFrequency_Hz = TMR_getCountFrequency_Hz(delayHandle);
+    TDLY_makeFactor(&nsFactor, tickFrequency_Hz, 1000000000);
+    TDLY_makeFactor(&usFactor, tickFrequency_Hz, 1000000);
+    
+#ifndef TMR_SIMULATION
+    ticksPerRtosTick = tickFrequency_Hz / configTICK_RATE_HZ;
+    maxSleepTicks = (ticksPerRtosTick != 0) ? (counterMask >> 1) / ticksPerRtosTick : 0;
+#endif
+    yieldThreshold = TDLY_convert(TDLY_YIELD_THRESHOLD_US, &usFactor);
+}
+
+//PR is claimed, so the count rate only changes if the clock didn't change by a power of two. A delay running across the change keeps the ticks it started with
+static void TDLY_clockHook(uint32_t oldClock_Hz, uint32_t newClock_Hz){
+    TDLY_updateRates();
+}
+
+uint32_t TDLY_init(TimerHandle_t * handle){
+    TimerState_t * state = TMR_getState(handle);
+    if(state == NULL || delayHandle != NULL) return pdFAIL;
+    
+    if(!TMR_addClockHook(TDLY_clockHook)) return pdFAIL;
+    delayHandle = handle;
+    
+    tmrReg = TMR_getTMRPointer(handle);
+    counterMask = (state->flags & TMR_FLAG_32BIT_MODE) ? 0xffffffff : 0xffff;
+    TDLY_updateRates();
+    
+    //free running over the full range, no interrupts needed
+    TMR_setIRQEnabled(handle, 0);
+    TMR_setEnabled(handle, 0);
+    TMR_claimPR(handle);
+    *TMR_getPRPointer(handle) = counterMask;
+    *tmrReg = 0;
+    TMR_setMode(handle, TmrMode_freeRunning);
+    TMR_setEnabled(handle, 1);
+    
+    //time the shortest possible delay call against two back to back counter reads, the difference is what a call costs on top of the wait
+    overhead = 0;
+    uint32_t minCall = counterMask;
+    uint32_t minRead = counterMask;
+    for(uint32_t i = 0; i < TDLY_CALIBRATION_RUNS; i++){
+        uint32_t start = *tmrReg;
+        uint32_t end = *tmrReg;
+        if(((end - start) & counterMask) < minRead) minRead = (end - start) & counterMask;
+        
+        start = *tmrReg;
+        TDLY_delay_ns(0);
+        end = *tmrReg;
+        if(((end - start) & counterMask) < minCall) minCall = (end - start) & counterMask;
+    }
+    overhead = minCall - minRead;
+    
+    return pdPASS;
+}
+
+void TDLY_deinit(){
+    TMR_removeClockHook(TDLY_clockHook);
+    delayHandle = NULL;
+    tmrReg = NULL;
+}
+
+void TDLY_delay_ns(uint32_t ns){
+    if(delayHandle == NULL) return;
+    
+    uint32_t start = *tmrReg;
+    TDLY_wait(start, TDLY_convert(ns, &nsFactor));
+}
+
+void TDLY_delay_us(uint32_t us){
+    if(delayHandle == NULL) return;
+    
+    uint32_t start = *tmrReg;
+    TDLY_wait(start, TDLY_convert(us, &usFactor));
+}
+
+uint32_t TDLY_now(){
+    if(delayHandle == NULL) return 0;
+    
+    return *tmrReg;
+}
+
+uint32_t TDLY_nsToTicks(uint32_t ns){
+    return TDLY_convert(ns, &nsFactor);
+}
+
+uint32_t TDLY_usToTicks(uint32_t us){
+    return TDLY_convert(us, &usFactor);
+}
+
+void TDLY_delayUntil(uint32_t deadline){
+    if(delayHandle == NULL) return;
+    
+    uint32_t start = *tmrReg;
+    uint32_t remaining = (deadline - start) & counterMask;
+    
+    //more than half a period away means the deadline has already passed
+    if(remaining > (counterMask >> 1)) return;
+    
+    TDLY_wait(start, remaining);
+}
+
+uint32_t TDLY_getOverhead(){
+    return overhead;
+}
@@ -0,0 +1,186 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef TMR_SIMULATION
+#include <xc.h>
+
+#if !__is_compiling || __has_include("FreeRTOS.h")
+#include "FreeRTOS.h"
+#endif
+#endif
+
+#include "Timer.h"
+#include "TimerConfig.h"
+#include "TimerExec.h"
+
+//jobs sorted by divider, fastest first
+static TimerJob_t * jobs[TCE_MAX_JOBS];
+static uint32_t jobCount = 0;
+
+//number of the frame that is running or ran last
+static uint32_t frame = 0;
+
+static TimerExecStats_t stats;
+
+static TimerHandle_t * execHandle = NULL;
+
+//the frame loop reads these directly instead of going through the handle
+static volatile uint32_t * tmrReg = NULL;
+static Pic32SetClearMap_t * ifsReg = NULL;
+static uint32_t intMask = 0;
+
+static uint32_t TCE_gcd(uint32_t a, uint32_t b){
+    while(b != 0){
+        uint32_t tmp = a % b;
+        a = b;
+        b = tmp;
+    }
+    return a;
+}
+
+static uint32_t TCE_isr(TimerHandle_t * handle, uint32_t flags, void * data){
+    frame++;
+    stats.frames++;
+    
+    uint32_t overrun = 0;
+    
+    for(uint32_t i = 0; i < jobCount; i++){
+        TimerJob_t * job = jobs[i];
+        
+        //a countdown per job instead of a modulo of the frame number, this is the only thing a job costs in frames it doesn't run in
+        if(--job->countdown != 0) continue;
+        job->countdown = job->divider;
+        
+        (*job->callback)(job->data);
+        job->runs++;
+        
+        //did the next period match happen while we were still busy? Only blame the first job that ran over
+        if(!overrun && (ifsReg->w & intMask)){
+            overrun = 1;
+            job->overruns++;
+            stats.overruns++;
+        }
+    }
+    
+    //the counter restarted at the match that started this frame, so it now holds the frame length. That is meaningless after an overrun
+    if(!overrun){
+        uint32_t length = *tmrReg;
+        if(length > stats.worstFrame) stats.worstFrame = length;
+    }
+    
+    return 0;
+}
+
+uint32_t TCE_init(TimerHandle_t * handle){
+    TimerState_t * state = TMR_getState(handle);
+    if(state == NULL || execHandle != NULL) return pdFAIL;
+    
+    if(!TMR_setISR(handle, TCE_isr, NULL)) return pdFAIL;
+    execHandle = handle;
+    
+    tmrReg = TMR_getTMRPointer(handle);
+    
+    //in 32bit mode the interrupt flag is the one of the slave timer
+    uint32_t irqTimer = (state->flags & TMR_FLAG_32BIT_MODE) ? state->number : state->number - 1;
+    ifsReg = Tmr_TimerMap[irqTimer].ifsReg;
+    intMask = Tmr_TimerMap[irqTimer].intMask;
+    
+    frame = 0;
+    TCE_resetStats();
+    
+    TMR_setMode(handle, TmrMode_freeRunning);
+    TMR_clearIFS(handle);
+    TMR_setIRQEnabled(handle, 1);
+    TMR_setEnabled(handle, 1);
+    
+    return pdPASS;
+}
+
+void TCE_deinit(){
+    if(execHandle == NULL) return;
+    
+    TMR_setIRQEnabled(execHandle, 0);
+    TMR_setISR(execHandle, NULL, NULL);
+    execHandle = NULL;
+}
+
+uint32_t TCE_addJob(TimerJob_t * job, TimerJobCallback_t callback, void * data, uint32_t divider){
+    if(job == NULL || callback == NULL || divider == 0 || jobCount >= TCE_MAX_JOBS) return pdFAIL;
+    for(uint32_t i = 0; i < jobCount; i++) if(jobs[i] == job) return pdFAIL;
+    
+    //find the phase that collides least with the other jobs. Two jobs meet every lcm(divider) frames if their phases match modulo the gcd of their dividers,
+    //weight every possible collision by how often it happens relative to our own runs
+    uint32_t bestPhase = 0;
+    uint32_t bestCost = 0xffffffff;
+    for(uint32_t phase = 0; phase < divider; phase++){
+        uint32_t cost = 0;
+        
+        for(uint32_t i = 0; i < jobCount; i++){
+            uint32_t gcd = TCE_gcd(divider, jobs[i]->divider);
+            if((phase % gcd) == (jobs[i]->phase % gcd)) cost += (gcd << 16) / jobs[i]->divider;
+        }
+        
+        if(cost < bestCost){
+            bestCost = cost;
+            bestPhase = phase;
+        }
+    }
+    
+    job->callback = callback;
+    job->data = data;
+    job->divider = divider;
+    job->phase = bestPhase;
+    job->runs = 0;
+    job->overruns = 0;
+    
+    //the table and the countdowns belong to the isr, keep it away while we change them
+    uint32_t irqEnabled = (execHandle != NULL) && TMR_isIRQEnabled(execHandle);
+    if(irqEnabled) TMR_setIRQEnabled(execHandle, 0);
+    
+    //line the countdown up with the phase relative to the global frame number, so the job runs in frames where frame % divider == phase
+    job->countdown = ((bestPhase + divider - (frame % divider) - 1) % divider) + 1;
+    
+    //insert sorted by divider, behind any jobs of the same rate
+    uint32_t index = jobCount;
+    while(index > 0 && jobs[index - 1]->divider > divider){
+        jobs[index] = jobs[index - 1];
+        index--;
+    }
+    jobs[index] = job;
+    jobCount++;
+    
+    if(irqEnabled) TMR_setIRQEnabled(execHandle, 1);
+    
+    return pdPASS;
+}
+
+void TCE_removeJob(TimerJob_t * job){
+    uint32_t irqEnabled = (execHandle != NULL) && TMR_isIRQEnabled(execHandle);
+    if(irqEnabled) TMR_setIRQEnabled(execHandle, 0);
+    
+    for(uint32_t i = 0; i < jobCount; i++){
+        if(jobs[i] != job) continue;
+        
+        for(uint32_t j = i + 1; j < jobCount; j++) jobs[j - 1] = jobs[j];
+        jobCount--;
+        break;
+    }
+    
+    if(irqEnabled) TMR_setIRQEnabled(execHandle, 1);
+}
+
+void TCE_getStats(TimerExecStats_t * ret){
+    uint32_t irqEnabled = (execHandle != NULL) && TMR_isIRQEnabled(execHandle);
+    if(irqEnabled) TMR_setIRQEnabled(execHandle, 0);
+    *ret = stats;
+    if(irqEnabled) TMR_setIRQEnabled(execHandle, 1);
+}
+
+void TCE_resetStats(){
+    uint32_t irqEnabled = (execHandle != NULL) && TMR_isIRQEnabled(execHandle);
+    if(irqEnabled) TMR_setIRQEnabled(execHandle, 0);
+    stats.frames = 0;
+    stats.overruns = 0;
+    stats.worstFrame = 0;
+    if(irqEnabled) TMR_setIRQEnabled(execHandle, 1);
+}
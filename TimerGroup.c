@@ -0,0 +1,112 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef TMR_SIMULATION
+#include <xc.h>
+
+#if !__is_compiling || __has_include("FreeRTOS.h")
+#include "FreeRTOS.h"
+#include "task.h"
+#endif
+#endif
+
+#include "Timer.h"
+#include "TimerConfig.h"
+#include "TimerGroup.h"
+
+void TGRP_init(TimerGroup_t * group){
+    group->count = 0;
+}
+
+uint32_t TGRP_add(TimerGroup_t * group, TimerHandle_t * handle, uint32_t phase){
+    TimerState_t * state = TMR_getState(handle);
+    if(state == NULL || group->count >= TGRP_MAX_MEMBERS) return pdFAIL;
+    
+    //a timer can only be in the group once
+    for(uint32_t i = 0; i < group->count; i++) if(group->members[i] == handle) return pdFAIL;
+    
+    TmrMap_t * regs = state->descriptor->registerMap;
+    
+    group->members[group->count] = handle;
+    group->phase[group->count] = phase;
+    group->tconSet[group->count] = (volatile uint32_t *) &regs->TCONSET;
+    group->tconClr[group->count] = (volatile uint32_t *) &regs->TCONCLR;
+    group->count++;
+    
+    return pdPASS;
+}
+
+uint32_t TGRP_remove(TimerGroup_t * group, TimerHandle_t * handle){
+    for(uint32_t i = 0; i < group->count; i++){
+        if(group->members[i] != handle) continue;
+        
+        //keep the order of the remaining members, it is what the skew compensation is based on
+        for(uint32_t j = i + 1; j < group->count; j++){
+            group->members[j - 1] = group->members[j];
+            group->phase[j - 1] = group->phase[j];
+            group->tconSet[j - 1] = group->tconSet[j];
+            group->tconClr[j - 1] = group->tconClr[j];
+        }
+        group->count--;
+        
+        return pdPASS;
+    }
+    
+    return pdFAIL;
+}
+
+//start and stop both go through this loop, so the delay between two writes is the same for both and the skews cancel out.
+//Members that were freed without being removed are left out, their timer may belong to someone else by now. The list is made first so the writes stay back to back
+static void TGRP_writeAll(TimerGroup_t * group, volatile uint32_t ** ports){
+    volatile uint32_t * live[TGRP_MAX_MEMBERS];
+    
+    TMR_ENTER_CRITICAL();
+    uint32_t count = 0;
+    for(uint32_t i = 0; i < group->count; i++) if(TMR_getState(group->members[i]) != NULL) live[count++] = ports[i];
+    
+    for(uint32_t i = 0; i < count; i++) *live[i] = _T1CON_TON_MASK;
+    TMR_EXIT_CRITICAL();
+}
+
+//keeps the shadows in line with what the write loop just did to the hardware. Members that were freed without being removed are skipped
+static void TGRP_setShadows(TimerGroup_t * group, uint32_t on){
+    for(uint32_t i = 0; i < group->count; i++){
+        TimerState_t * state = TMR_getState(group->members[i]);
+        if(state == NULL) continue;
+        
+        if(on) __sync_fetch_and_or(&state->tconShadow, _T1CON_TON_MASK);
+        else __sync_fetch_and_and(&state->tconShadow, ~_T1CON_TON_MASK);
+    }
+}
+
+void TGRP_start(TimerGroup_t * group){
+    TGRP_stop(group);
+    
+    //write slot of the next member, freed members don't get one
+    uint32_t slot = 0;
+    for(uint32_t i = 0; i < group->count; i++){
+        TimerHandle_t * handle = group->members[i];
+        if(TMR_getState(handle) == NULL) continue;
+        
+        //a member is started one write slot after the one before it, so it must already be that many counts further ahead
+        uint64_t skewCycles = (uint64_t) slot++ * TMR_GROUP_WRITE_SKEW_CYCLES;
+        uint32_t skewCounts = (skewCycles * TMR_getCountFrequency_Hz(handle) + (TMR_getClock_Hz() / 2)) / TMR_getClock_Hz();
+        
+        //the counter runs from 0 to PR, wrap the start value into that range
+        uint64_t periodCounts = (uint64_t) *TMR_getPRPointer(handle) + 1;
+        *TMR_getTMRPointer(handle) = ((uint64_t) group->phase[i] + skewCounts) % periodCounts;
+    }
+    
+    TGRP_writeAll(group, group->tconSet);
+    TGRP_setShadows(group, 1);
+}
+
+void TGRP_stop(TimerGroup_t * group){
+    TGRP_writeAll(group, group->tconClr);
+    TGRP_setShadows(group, 0);
+}
+
+void TGRP_resume(TimerGroup_t * group){
+    TGRP_writeAll(group, group->tconSet);
+    TGRP_setShadows(group, 1);
+}
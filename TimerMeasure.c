@@ -0,0 +1,247 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef TMR_SIMULATION
+#include <xc.h>
+
+#if !__is_compiling || __has_include("FreeRTOS.h")
+#include "FreeRTOS.h"
+#endif
+#endif
+
+#include "Timer.h"
+#include "TimerConfig.h"
+#include "TimerConst.h"
+#include "TimerMeasure.h"
+
+#if TMS_AVERAGE_LENGTH & (TMS_AVERAGE_LENGTH - 1)
+    #error "TMS_AVERAGE_LENGTH must be a power of two"
+#endif
+
+//snapshot of the averaging buffers, summed up
+typedef struct{
+    uint64_t counts;
+    uint64_t pulses;
+    uint64_t cycles;
+} MeasureSums_t;
+
+//divider shift of the prescaler the driver last wrote to a timer. The shadow is used since the write might not have reached TCON yet in the simulation
+static uint32_t TMS_getShift(TimerHandle_t * handle){
+    TimerState_t * state = TMR_getState(handle);
+    uint32_t mask = (state->descriptor->type == TmrType_A) ? TMR_TYPEA_TCKPS_MASK : TMR_TYPEB_TCKPS_MASK;
+    return TMR_CONST_SHIFT(state->descriptor->type, (state->tconShadow & mask) >> TMR_TCKPS_POSITION);
+}
+
+static uint32_t TMS_counterIsr(TimerHandle_t * handle, uint32_t flags, void * data){
+    TimerMeasure_t * measure = data;
+    
+    //in frequency mode the interrupt is the counter wrapping, in pulse width mode a falling edge of the gate
+    if(measure->mode == TmsMode_Frequency) measure->overflows++;
+    else measure->edges++;
+    
+    return 0;
+}
+
+static uint32_t TMS_windowIsr(TimerHandle_t * handle, uint32_t flags, void * data){
+    TimerMeasure_t * measure = data;
+    volatile uint32_t * tmrReg = TMR_getTMRPointer(measure->counter);
+    uint32_t count;
+    
+    if(measure->mode == TmsMode_Frequency){
+        //extend the counter with the overflow count, same double read as in TimerTimestamp.c in case the counter isr has a lower priority than us
+        uint64_t range = (uint64_t) *TMR_getPRPointer(measure->counter) + 1;
+        uint32_t before;
+        uint32_t low;
+        uint32_t pending;
+        do{
+            before = measure->overflows;
+            low = *tmrReg;
+            pending = TMR_readIFS(measure->counter) && (low < (range >> 1));
+        }while(before != measure->overflows);
+        
+        uint64_t total = (before + pending) * range + low;
+        count = (uint32_t) (total - measure->lastTotal);
+        measure->lastTotal = total;
+    }else{
+        //the prescaler makes sure the counter can't overflow within a window, so just take what it accumulated and start over
+        count = *tmrReg;
+        *tmrReg = 0;
+    }
+    
+    uint32_t edges = measure->edges;
+    uint32_t index = measure->index;
+    measure->counts[index] = count;
+    measure->pulses[index] = edges - measure->lastEdges;
+    measure->lastEdges = edges;
+    
+    measure->index = (index + 1) & (TMS_AVERAGE_LENGTH - 1);
+    if(measure->filled < TMS_AVERAGE_LENGTH) measure->filled++;
+    
+    if(measure->callback != NULL && ++measure->decimationCount >= measure->decimation){
+        measure->decimationCount = 0;
+        (*measure->callback)(measure, measure->data);
+    }
+    
+    return 0;
+}
+
+//takes back what TMS_init set up. Only the isrs TMS_init actually bound are cleared, a failed TMR_setISR means the timer already had someone else's
+static void TMS_undo(TimerMeasure_t * measure){
+    TMR_setEnabled(measure->window, 0);
+    TMR_setEnabled(measure->counter, 0);
+    TMR_setIRQEnabled(measure->window, 0);
+    TMR_setIRQEnabled(measure->counter, 0);
+    if(TMR_getISR(measure->window).function == TMS_windowIsr) TMR_setISR(measure->window, NULL, NULL);
+    if(TMR_getISR(measure->counter).function == TMS_counterIsr) TMR_setISR(measure->counter, NULL, NULL);
+    
+    //back to the peripheral clock
+    TMR_setClockSource(measure->counter, 0, 0, 0);
+}
+
+uint32_t TMS_init(TimerMeasure_t * measure, TimerMeasureMode_t mode, TimerHandle_t * counter, TimerHandle_t * window, uint32_t window_us){
+    TimerState_t * counterState = TMR_getState(counter);
+    if(measure == NULL || counterState == NULL || !TMR_isHandleAllocated(window) || counter == window) return pdFAIL;
+    
+    measure->counter = counter;
+    measure->window = window;
+    measure->mode = mode;
+    measure->callback = NULL;
+    measure->overflows = 0;
+    measure->edges = 0;
+    measure->lastTotal = 0;
+    measure->lastEdges = 0;
+    TMS_reset(measure);
+    
+    if(!TMR_setPeriod(window, window_us)) return pdFAIL;
+    measure->windowCycles = (*TMR_getPRPointer(window) + 1) << TMS_getShift(window);
+    
+    uint32_t counterMax = (counterState->flags & TMR_FLAG_32BIT_MODE) ? 0xffffffff : 0xffff;
+    
+    TMR_setEnabled(counter, 0);
+    TMR_setIRQEnabled(counter, 0);
+    
+    if(mode == TmsMode_Frequency){
+        //count the edges on the clock pin, synchronised to the peripheral clock
+        TMR_setClockSource(counter, 1, 0, 1);
+        TMR_setPrescaler(counter, 0);
+    }else{
+        //count the peripheral clock while the gate pin is high. Pick the finest prescaler a whole window fits into
+        TMR_setClockSource(counter, 0, 1, 0);
+        
+        uint32_t prescalerCount = (counterState->descriptor->type == TmrType_A) ? 4 : 8;
+        uint32_t prescaler = 0;
+        while(prescaler < prescalerCount && (measure->windowCycles >> TMR_CONST_SHIFT(counterState->descriptor->type, prescaler)) >= counterMax) prescaler++;
+        if(prescaler == prescalerCount){
+            TMS_undo(measure);
+            return pdFAIL;
+        }
+        
+        TMR_setPrescaler(counter, prescaler);
+    }
+    measure->counterShift = TMS_getShift(counter);
+    
+    TMR_claimPR(counter);
+    *TMR_getPRPointer(counter) = counterMax;
+    *TMR_getTMRPointer(counter) = 0;
+    TMR_clearIFS(counter);
+    
+    //either timer might already have an isr bound by someone else
+    TMR_setMode(counter, TmrMode_freeRunning);
+    TMR_setMode(window, TmrMode_freeRunning);
+    if(!TMR_setISR(counter, TMS_counterIsr, measure) || !TMR_setISR(window, TMS_windowIsr, measure)){
+        TMS_undo(measure);
+        return pdFAIL;
+    }
+    
+    TMR_setIRQEnabled(counter, 1);
+    TMR_clearIFS(window);
+    TMR_setIRQEnabled(window, 1);
+    
+    //start both as close together as possible, the first window is a bit off anyway
+    TMR_setEnabled(counter, 1);
+    TMR_setEnabled(window, 1);
+    
+    return pdPASS;
+}
+
+void TMS_deinit(TimerMeasure_t * measure){
+    TMS_undo(measure);
+}
+
+void TMS_setCallback(TimerMeasure_t * measure, TimerMeasureCallback_t callback, void * data, uint32_t decimation){
+    uint32_t irqEnabled = TMR_isIRQEnabled(measure->window);
+    TMR_setIRQEnabled(measure->window, 0);
+    
+    measure->callback = callback;
+    measure->data = data;
+    measure->decimation = decimation ? decimation : 1;
+    measure->decimationCount = 0;
+    
+    TMR_setIRQEnabled(measure->window, irqEnabled);
+}
+
+void TMS_reset(TimerMeasure_t * measure){
+    uint32_t irqEnabled = measure->window != NULL && TMR_isIRQEnabled(measure->window);
+    if(irqEnabled) TMR_setIRQEnabled(measure->window, 0);
+    
+    measure->index = 0;
+    measure->filled = 0;
+    
+    if(irqEnabled) TMR_setIRQEnabled(measure->window, 1);
+}
+
+//sums up all complete windows with the window isr kept out
+static void TMS_sum(TimerMeasure_t * measure, MeasureSums_t * sums){
+    sums->counts = 0;
+    sums->pulses = 0;
+    
+    uint32_t irqEnabled = TMR_isIRQEnabled(measure->window);
+    TMR_setIRQEnabled(measure->window, 0);
+    
+    uint32_t filled = measure->filled;
+    for(uint32_t i = 0; i < filled; i++){
+        sums->counts += measure->counts[i];
+        sums->pulses += measure->pulses[i];
+    }
+    
+    TMR_setIRQEnabled(measure->window, irqEnabled);
+    
+    //the settings might have changed with the peripheral clock since the measurement started
+    measure->windowCycles = (*TMR_getPRPointer(measure->window) + 1) << TMS_getShift(measure->window);
+    measure->counterShift = TMS_getShift(measure->counter);
+    
+    sums->cycles = (uint64_t) filled * measure->windowCycles;
+}
+
+uint32_t TMS_getFrequency_mHz(TimerMeasure_t * measure){
+    MeasureSums_t sums;
+    TMS_sum(measure, &sums);
+    if(sums.cycles == 0) return 0;
+    
+    //edges are counted by the counter itself in frequency mode and by the falling edge interrupt in pulse width mode
+    uint64_t edges = (measure->mode == TmsMode_Frequency) ? sums.counts : sums.pulses;
+    uint64_t frequency_mHz = (edges * TMR_getClock_Hz() * 1000 + (sums.cycles >> 1)) / sums.cycles;
+    return (frequency_mHz > 0xffffffff) ? 0xffffffff : (uint32_t) frequency_mHz;
+}
+
+uint32_t TMS_getPulseWidth_ns(TimerMeasure_t * measure){
+    if(measure->mode != TmsMode_PulseWidth) return 0;
+    
+    MeasureSums_t sums;
+    TMS_sum(measure, &sums);
+    if(sums.pulses == 0) return 0;
+    
+    uint64_t highCycles = sums.counts << measure->counterShift;
+    return (highCycles * 1000000000ull) / ((uint64_t) TMR_getClock_Hz() * sums.pulses);
+}
+
+uint32_t TMS_getDutyCycle_ppm(TimerMeasure_t * measure){
+    if(measure->mode != TmsMode_PulseWidth) return 0;
+    
+    MeasureSums_t sums;
+    TMS_sum(measure, &sums);
+    if(sums.cycles == 0) return 0;
+    
+    uint64_t highCycles = sums.counts << measure->counterShift;
+    return (highCycles * 1000000) / sums.cycles;
+}
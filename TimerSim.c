@@ -0,0 +1,257 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "Timer.h"
+#include "TimerConfig.h"
+#include "TimerSim.h"
+
+#if TMR_NUM_TIMERS != TMR_SIM_NUM_TIMERS
+    #error "TMR_NUM_TIMERS in TimerConfig.h must match the simulated device when building with TMR_SIMULATION"
+#endif
+
+//register file of the simulated device. Not static so the fast path API in TimerFast.h can address it directly
+TmrMap_t Tmr_SimTimers[TMR_SIM_NUM_TIMERS];
+Pic32SetClearMap_t Tmr_SimIEC0;
+Pic32SetClearMap_t Tmr_SimIFS0;
+static Pic32SetClearMap_t simIPC[TMR_SIM_NUM_TIMERS];
+
+//state of the prescaler counters, these aren't visible in the registers on the real hardware either
+static uint32_t simPrescaleCount[TMR_SIM_NUM_TIMERS];
+
+//number of clock cycles simulated since the last reset
+static uint64_t simCycles = 0;
+
+//kernel state for TimerTickless.c
+static eSleepModeStatus simSleepStatus = eStandardSleep;
+static uint32_t simSteppedTicks = 0;
+
+static uint32_t simTypeAPrescalersShifts[4] = {0, 3, 6, 8};
+static uint32_t simTypeBPrescalersShifts[8] = {0, 1, 2, 3, 4, 5, 6, 8};
+
+//register map of the simulated device, same layout as the pic32mx1xx/2xx map in TimerConfig.c
+const TimerDescriptor_t Tmr_TimerMap[TMR_NUM_TIMERS] =
+    {
+        [0] = {.type = TmrType_A, .registerMap = &Tmr_SimTimers[0], .iecReg = &Tmr_SimIEC0, .ifsReg = &Tmr_SimIFS0, .intMask = 1 << 4, .ipcReg = &simIPC[0], .ipcOffset = 0, .interruptNumber = 4, .interruptVector = 4},
+        [1] = {.type = TmrType_B_Master, .registerMap = &Tmr_SimTimers[1], .iecReg = &Tmr_SimIEC0, .ifsReg = &Tmr_SimIFS0, .intMask = 1 << 9, .ipcReg = &simIPC[1], .ipcOffset = 0, .interruptNumber = 9, .interruptVector = 8},
+        [2] = {.type = TmrType_B_Slave, .registerMap = &Tmr_SimTimers[2], .iecReg = &Tmr_SimIEC0, .ifsReg = &Tmr_SimIFS0, .intMask = 1 << 14, .ipcReg = &simIPC[2], .ipcOffset = 0, .interruptNumber = 14, .interruptVector = 12},
+        [3] = {.type = TmrType_B_Master, .registerMap = &Tmr_SimTimers[3], .iecReg = &Tmr_SimIEC0, .ifsReg = &Tmr_SimIFS0, .intMask = 1 << 19, .ipcReg = &simIPC[3], .ipcOffset = 0, .interruptNumber = 19, .interruptVector = 16},
+        [4] = {.type = TmrType_B_Slave, .registerMap = &Tmr_SimTimers[4], .iecReg = &Tmr_SimIEC0, .ifsReg = &Tmr_SimIFS0, .intMask = 1 << 24, .ipcReg = &simIPC[4], .ipcOffset = 0, .interruptNumber = 24, .interruptVector = 20}
+    };
+
+//applies the write ports of a set/clear register
+static void TMR_SIM_foldSetClear(uint32_t * reg, uint32_t * clr, uint32_t * set, uint32_t * inv){
+    *reg &= ~*clr;
+    *reg |= *set;
+    *reg ^= *inv;
+
+    *clr = 0;
+    *set = 0;
+    *inv = 0;
+}
+
+static void TMR_SIM_foldPic32Map(Pic32SetClearMap_t * reg){
+    TMR_SIM_foldSetClear(&reg->w, &reg->CLR, &reg->SET, &reg->INV);
+}
+
+void TMR_SIM_sync(){
+    for(uint32_t i = 0; i < TMR_SIM_NUM_TIMERS; i++){
+        TmrMap_t * regs = &Tmr_SimTimers[i];
+        TMR_SIM_foldSetClear((uint32_t *) &regs->TCON, (uint32_t *) &regs->TCONCLR, (uint32_t *) &regs->TCONSET, (uint32_t *) &regs->TCONINV);
+        TMR_SIM_foldSetClear(&regs->TMR, &regs->TMRCLR, &regs->TMRSET, &regs->TMRINV);
+        TMR_SIM_foldSetClear(&regs->PR, &regs->PRCLR, &regs->PRSET, &regs->PRINV);
+
+        TMR_SIM_foldPic32Map(&simIPC[i]);
+    }
+
+    TMR_SIM_foldPic32Map(&Tmr_SimIEC0);
+    TMR_SIM_foldPic32Map(&Tmr_SimIFS0);
+}
+
+//folds only the register group a write went to. Every group is 4 words (base, CLR, SET, INV) and the register file is made of nothing else
+void TMR_SIM_syncRegister(volatile uint32_t * reg){
+    uintptr_t address = (uintptr_t) reg;
+    uintptr_t start = 0;
+
+    if(address >= (uintptr_t) Tmr_SimTimers && address < (uintptr_t) Tmr_SimTimers + sizeof(Tmr_SimTimers)) start = (uintptr_t) Tmr_SimTimers;
+    else if(address >= (uintptr_t) simIPC && address < (uintptr_t) simIPC + sizeof(simIPC)) start = (uintptr_t) simIPC;
+    else if(address >= (uintptr_t) &Tmr_SimIEC0 && address < (uintptr_t) &Tmr_SimIEC0 + sizeof(Tmr_SimIEC0)) start = (uintptr_t) &Tmr_SimIEC0;
+    else if(address >= (uintptr_t) &Tmr_SimIFS0 && address < (uintptr_t) &Tmr_SimIFS0 + sizeof(Tmr_SimIFS0)) start = (uintptr_t) &Tmr_SimIFS0;
+
+    //not part of the register file, fold everything to be safe
+    if(start == 0){
+        TMR_SIM_sync();
+        return;
+    }
+
+    uint32_t * group = (uint32_t *) (start + ((address - start) & ~(uintptr_t) (4 * sizeof(uint32_t) - 1)));
+    TMR_SIM_foldSetClear(&group[0], &group[1], &group[2], &group[3]);
+}
+
+void TMR_SIM_reset(){
+    memset(Tmr_SimTimers, 0, sizeof(Tmr_SimTimers));
+    memset(&Tmr_SimIEC0, 0, sizeof(Tmr_SimIEC0));
+    memset(&Tmr_SimIFS0, 0, sizeof(Tmr_SimIFS0));
+    memset(simIPC, 0, sizeof(simIPC));
+    memset(simPrescaleCount, 0, sizeof(simPrescaleCount));
+
+    //PR resets to all ones on the real hardware
+    for(uint32_t i = 0; i < TMR_SIM_NUM_TIMERS; i++) Tmr_SimTimers[i].PR = 0xffff;
+
+    simCycles = 0;
+    simSleepStatus = eStandardSleep;
+    simSteppedTicks = 0;
+}
+
+uint64_t TMR_SIM_getCycles(){
+    return simCycles;
+}
+
+//is the timer at index i currently counting? Slaves of a 32bit pair are counted by their master
+static uint32_t TMR_SIM_isCounting(uint32_t i){
+    if(Tmr_TimerMap[i].type == TmrType_B_Slave && Tmr_SimTimers[i - 1].TCON.T32) return 0;
+
+    //external clock sources are not simulated, the counter just stands still
+    return Tmr_SimTimers[i].TCON.ON && !Tmr_SimTimers[i].TCON.TCS;
+}
+
+static uint32_t TMR_SIM_getShift(uint32_t i){
+    if(Tmr_TimerMap[i].type == TmrType_A) return simTypeAPrescalersShifts[Tmr_SimTimers[i].TCON.TYPEA_TCKPS];
+    return simTypeBPrescalersShifts[Tmr_SimTimers[i].TCON.TYPEB_TCKPS];
+}
+
+static uint32_t TMR_SIM_getMax(uint32_t i){
+    return (Tmr_TimerMap[i].type == TmrType_B_Master && Tmr_SimTimers[i].TCON.T32) ? 0xffffffff : 0xffff;
+}
+
+//index of the timer whose IFS bit gets set on a period match. In 32bit mode that is the slave
+static uint32_t TMR_SIM_getIrqIndex(uint32_t i){
+    return (Tmr_TimerMap[i].type == TmrType_B_Master && Tmr_SimTimers[i].TCON.T32) ? i + 1 : i;
+}
+
+//number of timer clocks until the next period match. TMR resets to 0 on the clock after it reached PR
+static uint64_t TMR_SIM_ticksToMatch(uint32_t i){
+    uint64_t max = TMR_SIM_getMax(i);
+    uint64_t tmr = Tmr_SimTimers[i].TMR & max;
+    uint64_t pr = Tmr_SimTimers[i].PR & max;
+
+    //is the counter already past the period? If so it first needs to roll over
+    if(tmr > pr) return (max - tmr + 1) + pr + 1;
+    return pr - tmr + 1;
+}
+
+static uint64_t TMR_SIM_cyclesToMatch(uint32_t i){
+    uint32_t shift = TMR_SIM_getShift(i);
+    return (TMR_SIM_ticksToMatch(i) << shift) - simPrescaleCount[i];
+}
+
+//advances a single timer by a number of clock cycles. Must never be called with more cycles than there are until the next match
+static void TMR_SIM_count(uint32_t i, uint64_t cycles){
+    uint32_t shift = TMR_SIM_getShift(i);
+    uint64_t total = (uint64_t) simPrescaleCount[i] + cycles;
+    uint64_t ticks = total >> shift;
+    simPrescaleCount[i] = total & ((1 << shift) - 1);
+
+    if(ticks == 0) return;
+
+    uint32_t max = TMR_SIM_getMax(i);
+    if(ticks == TMR_SIM_ticksToMatch(i)){
+        //period match, reset the counter and flag the interrupt
+        Tmr_SimTimers[i].TMR = 0;
+        Tmr_TimerMap[TMR_SIM_getIrqIndex(i)].ifsReg->w |= Tmr_TimerMap[TMR_SIM_getIrqIndex(i)].intMask;
+    }else{
+        Tmr_SimTimers[i].TMR = ((Tmr_SimTimers[i].TMR & max) + ticks) & max;
+    }
+}
+
+//is the interrupt of the timer at index i flagged and enabled?
+static uint32_t TMR_SIM_isPending(uint32_t i){
+    const TimerDescriptor_t * desc = &Tmr_TimerMap[i];
+    return (desc->ifsReg->w & desc->intMask) && (desc->iecReg->w & desc->intMask);
+}
+
+//number of cycles until the closest period match of any counting timer, at most limit
+static uint64_t TMR_SIM_nextMatch(uint64_t limit){
+    for(uint32_t i = 0; i < TMR_SIM_NUM_TIMERS; i++){
+        if(!TMR_SIM_isCounting(i)) continue;
+        uint64_t toMatch = TMR_SIM_cyclesToMatch(i);
+        if(toMatch < limit) limit = toMatch;
+    }
+
+    return limit;
+}
+
+static void TMR_SIM_step(uint64_t cycles){
+    for(uint32_t i = 0; i < TMR_SIM_NUM_TIMERS; i++){
+        if(TMR_SIM_isCounting(i)) TMR_SIM_count(i, cycles);
+    }
+
+    simCycles += cycles;
+}
+
+void TMR_SIM_dispatchPending(){
+    TMR_SIM_sync();
+
+    //keep going until no more interrupts are pending, an isr might have caused another one
+    uint32_t found = 1;
+    while(found){
+        found = 0;
+        for(uint32_t i = 0; i < TMR_SIM_NUM_TIMERS; i++){
+            const TimerDescriptor_t * desc = &Tmr_TimerMap[i];
+            if(TMR_SIM_isPending(i)){
+                //same as the generated ISRs in TimerConfig.c
+                TMR_ISR_ENTRY(i);
+                desc->ifsReg->w &= ~desc->intMask;
+                TMR_isrHandler(i);
+                TMR_SIM_sync();
+                found = 1;
+            }
+        }
+    }
+}
+
+void TMR_SIM_advance(uint64_t cycles){
+    TMR_SIM_dispatchPending();
+
+    while(cycles > 0){
+        //go from one match to the next so interrupts of different timers are called in the right order
+        uint64_t step = TMR_SIM_nextMatch(cycles);
+        TMR_SIM_step(step);
+        cycles -= step;
+
+        TMR_SIM_dispatchPending();
+    }
+}
+
+void TMR_SIM_wait(){
+    TMR_SIM_sync();
+
+    while(1){
+        //can anything still wake us up?
+        uint32_t wakeable = 0;
+        for(uint32_t i = 0; i < TMR_SIM_NUM_TIMERS; i++){
+            if(TMR_SIM_isPending(i)) return;
+
+            const TimerDescriptor_t * irq = &Tmr_TimerMap[TMR_SIM_getIrqIndex(i)];
+            if(TMR_SIM_isCounting(i) && (irq->iecReg->w & irq->intMask)) wakeable = 1;
+        }
+        if(!wakeable) return;
+
+        TMR_SIM_step(TMR_SIM_nextMatch(UINT64_MAX));
+    }
+}
+
+eSleepModeStatus eTaskConfirmSleepModeStatus(){
+    return simSleepStatus;
+}
+
+void vTaskStepTick(uint32_t ticks){
+    simSteppedTicks += ticks;
+}
+
+void TMR_SIM_setSleepStatus(eSleepModeStatus status){
+    simSleepStatus = status;
+}
+
+uint32_t TMR_SIM_getSteppedTicks(){
+    return simSteppedTicks;
+}
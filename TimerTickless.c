@@ -0,0 +1,160 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef TMR_SIMULATION
+#include <xc.h>
+
+#if !__is_compiling || __has_include("FreeRTOS.h")
+#include "FreeRTOS.h"
+#include "task.h"
+#endif
+#endif
+
+#include "Timer.h"
+#include "TimerConfig.h"
+#include "TimerTickless.h"
+
+static TimerHandle_t * ttlHandle = NULL;
+
+//wake up timer registers, the interrupt ones are those of the slave
+static volatile uint32_t * wakeTmr = NULL;
+static volatile uint32_t * wakePr = NULL;
+static Pic32SetClearMap_t * wakeIfs = NULL;
+static uint32_t wakeMask = 0;
+static uint32_t wakeShift = 0;
+
+//the timer the RTOS tick comes from
+static const TimerDescriptor_t * tickTimer = NULL;
+
+static uint32_t cyclesPerTick = 0;
+static uint32_t maxIdleTicks = 0;
+static uint32_t sleptTicks = 0;
+
+//only there so the handler finds something to call. The flag is always cleared before interrupts are enabled again
+static uint32_t TTL_isr(TimerHandle_t * handle, uint32_t flags, void * data){
+    return 0;
+}
+
+//everything that depends on the peripheral clock and the count rate of the wake up timer
+static void TTL_updateRates(){
+    //a count of the wake up timer is 2^wakeShift peripheral clocks
+    wakeShift = 31 - __builtin_clz(TMR_getClock_Hz() / TMR_getCountFrequency_Hz(ttlHandle));
+    
+    cyclesPerTick = TMR_getClock_Hz() / configTICK_RATE_HZ;
+    
+    //longest sleep the 32bit counter can cover, with one tick to spare for the phase of the current tick
+    maxIdleTicks = (uint32_t) ((0xffffffffull << wakeShift) / cyclesPerTick) - 1;
+}
+
+//TTL_suppressTicksAndSleep reads the rates with interrupts disabled, a clock change can't come in half way through a sleep
+static void TTL_clockHook(uint32_t oldClock_Hz, uint32_t newClock_Hz){
+    TTL_updateRates();
+}
+
+uint32_t TTL_init(TimerHandle_t * handle){
+    TimerState_t * state = TMR_getState(handle);
+    if(state == NULL || ttlHandle != NULL || !(state->flags & TMR_FLAG_32BIT_MODE)) return pdFAIL;
+    
+    //find the tick timer. If the port runs the tick from the core timer there is nothing we can do
+    for(uint32_t i = 0; i < TMR_NUM_TIMERS; i++){
+        if(Tmr_TimerMap[i].interruptVector == configTICK_INTERRUPT_VECTOR) tickTimer = &Tmr_TimerMap[i];
+    }
+    if(tickTimer == NULL) return pdFAIL;
+    
+    if(!TMR_setISR(handle, TTL_isr, NULL)) return pdFAIL;
+    if(!TMR_addClockHook(TTL_clockHook)){
+        TMR_setISR(handle, NULL, NULL);
+        return pdFAIL;
+    }
+    ttlHandle = handle;
+    
+    wakeTmr = TMR_getTMRPointer(handle);
+    wakePr = TMR_getPRPointer(handle);
+    TMR_claimPR(handle);
+    wakeIfs = Tmr_TimerMap[state->number].ifsReg;
+    wakeMask = Tmr_TimerMap[state->number].intMask;
+    TTL_updateRates();
+    
+    TMR_setEnabled(handle, 0);
+    TMR_setMode(handle, TmrMode_SingleShot);
+    TMR_clearIFS(handle);
+    
+    return pdPASS;
+}
+
+void TTL_deinit(){
+    if(ttlHandle == NULL) return;
+    
+    TMR_setEnabled(ttlHandle, 0);
+    TMR_setIRQEnabled(ttlHandle, 0);
+    TMR_setISR(ttlHandle, NULL, NULL);
+    TMR_removeClockHook(TTL_clockHook);
+    ttlHandle = NULL;
+    tickTimer = NULL;
+}
+
+void TTL_suppressTicksAndSleep(uint32_t expectedIdleTicks){
+    if(ttlHandle == NULL || expectedIdleTicks < TTL_MIN_IDLE_TICKS) return;
+    if(expectedIdleTicks > maxIdleTicks) expectedIdleTicks = maxIdleTicks;
+    
+    __builtin_disable_interrupts();
+    
+    //did a task get ready or a tick come in while we got here? Then there is no point in sleeping
+    if(eTaskConfirmSleepModeStatus() == eAbortSleep || (tickTimer->ifsReg->w & tickTimer->intMask)){
+        __builtin_enable_interrupts();
+        return;
+    }
+    
+    //time since the last tick in peripheral clocks
+    uint32_t tickPr = tickTimer->registerMap->PR + 1;
+    uint32_t tickShift = 31 - __builtin_clz((cyclesPerTick + (tickPr >> 1)) / tickPr);
+    uint32_t phase = tickTimer->registerMap->TMR << tickShift;
+    
+    //wake up right at the tick the next task is due in. If the phase and the overhead already use that up, or less than one count of the wake up timer is left, don't sleep at all
+    uint64_t idleCycles = (uint64_t) expectedIdleTicks * cyclesPerTick;
+    uint64_t spentCycles = (uint64_t) phase + TTL_OVERHEAD_CYCLES;
+    uint32_t wakeCounts = (idleCycles > spentCycles) ? (uint32_t) ((idleCycles - spentCycles) >> wakeShift) : 0;
+    if(wakeCounts == 0){
+        __builtin_enable_interrupts();
+        return;
+    }
+    
+    //keep the tick from waking us, the timer itself keeps counting so its phase stays right
+    tickTimer->iecReg->CLR = tickTimer->intMask;
+    
+    *wakeTmr = 0;
+    *wakePr = wakeCounts - 1;
+    wakeIfs->CLR = wakeMask;
+    TMR_setIRQEnabled(ttlHandle, 1);
+    TMR_setEnabled(ttlHandle, 1);
+    
+    //with interrupts disabled the cpu still wakes up on any enabled interrupt, it just continues here instead of going to the isr
+    TTL_PRE_SLEEP();
+    TTL_WAIT();
+    TTL_POST_SLEEP();
+    
+    TMR_setEnabled(ttlHandle, 0);
+    
+    //the counter went back to 0 if the wake up timer is what woke us
+    uint64_t elapsed = *wakeTmr;
+    if(wakeIfs->w & wakeMask) elapsed += (uint64_t) *wakePr + 1;
+    elapsed = (elapsed << wakeShift) + phase + TTL_OVERHEAD_CYCLES;
+    
+    wakeIfs->CLR = wakeMask;
+    TMR_setIRQEnabled(ttlHandle, 0);
+    
+    //number of tick boundaries we slept through. The tick timer flagged the last one itself, that one is left to the tick isr so it can unblock the task that is due
+    uint32_t ticks = elapsed / cyclesPerTick;
+    if(ticks > expectedIdleTicks) ticks = expectedIdleTicks;
+    if(ticks > 1){
+        vTaskStepTick(ticks - 1);
+        sleptTicks += ticks - 1;
+    }
+    
+    tickTimer->iecReg->SET = tickTimer->intMask;
+    __builtin_enable_interrupts();
+}
+
+uint32_t TTL_getSleptTicks(){
+    return sleptTicks;
+}
@@ -0,0 +1,175 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef TMR_SIMULATION
+#include <xc.h>
+
+#if !__is_compiling || __has_include("FreeRTOS.h")
+#include "FreeRTOS.h"
+#endif
+#endif
+
+#include "Timer.h"
+#include "TimerConfig.h"
+#include "TimerTimestamp.h"
+
+//fixed point factor to convert ticks into some unit: units = (ticks * mult) >> shift
+typedef struct{
+    uint32_t mult;
+    uint32_t shift;
+} TimestampFactor_t;
+
+//number of times the counter wrapped around. Together with the counter this makes up the 64bit timestamp
+static volatile uint32_t overflowCount = 0;
+
+static TimerHandle_t * tsHandle = NULL;
+
+//the read path uses these directly instead of going through the handle
+static volatile uint32_t * tmrReg = NULL;
+static Pic32SetClearMap_t * ifsReg = NULL;
+static uint32_t intMask = 0;
+
+static uint32_t tickFrequency_Hz = 0;
+static TimestampFactor_t nsFactor;
+static TimestampFactor_t usFactor;
+
+//tick count and time of the last rate change. Ticks from before it were counted at the old rate, so only the ones after it are converted with the current factors
+static uint64_t epochTicks = 0;
+static uint64_t epochNs = 0;
+static uint64_t epochUs = 0;
+
+static uint32_t TTS_isr(TimerHandle_t * handle, uint32_t flags, void * data){
+    overflowCount++;
+    return 0;
+}
+
+//finds the factor with the most precision that still fits into 32bit. Only runs during init and on clock changes so the 64bit division is fine here.
+//The factor is rounded up, the conversion truncates and would otherwise return a whole number of units one short
+static void TTS_makeFactor(TimestampFactor_t * factor, uint32_t unitsPerSecond){
+    for(uint32_t shift = 32; shift > 0; shift--){
+        uint64_t mult = (((uint64_t) unitsPerSecond << shift) + tickFrequency_Hz - 1) / tickFrequency_Hz;
+        if(mult <= 0xffffffff){
+            factor->mult = (uint32_t) mult;
+            factor->shift = shift;
+            return;
+        }
+    }
+
+    factor->mult = 0xffffffff;
+    factor->shift = 0;
+}
+
+static uint64_t TTS_convert(uint64_t ticks, TimestampFactor_t * factor){
+    //split into two 32x32 bit multiplications so the product never needs more than 64bit
+    uint64_t high = (uint64_t) (uint32_t) (ticks >> 32) * factor->mult;
+    uint64_t low = (uint64_t) (uint32_t) ticks * factor->mult;
+
+    return (high << (32 - factor->shift)) + (low >> factor->shift);
+}
+
+//a clock change that isn't a power of two leaves the counter with a new rate, the time counted up to here is kept
+static void TTS_clockHook(uint32_t oldClock_Hz, uint32_t newClock_Hz){
+    uint32_t frequency_Hz = TMR_getCountFrequency_Hz(tsHandle);
+    if(frequency_Hz == 0 || frequency_Hz == tickFrequency_Hz) return;
+
+    TMR_ENTER_CRITICAL();
+    uint64_t ticks = TTS_getTicks();
+    epochNs += TTS_convert(ticks - epochTicks, &nsFactor);
+    epochUs += TTS_convert(ticks - epochTicks, &usFactor);
+    epochTicks = ticks;
+
+    tickFrequency_Hz = frequency_Hz;
+    TTS_makeFactor(&nsFactor, 1000000000);
+    TTS_makeFactor(&usFactor, 1000000);
+    TMR_EXIT_CRITICAL();
+}
+
+uint32_t TTS_init(TimerHandle_t * handle){
+    TimerState_t * state = TMR_getState(handle);
+    if(state == NULL || tsHandle != NULL || !(state->flags & TMR_FLAG_32BIT_MODE)) return pdFAIL;
+
+    if(!TMR_setISR(handle, TTS_isr, NULL)) return pdFAIL;
+    if(!TMR_addClockHook(TTS_clockHook)){
+        TMR_setISR(handle, NULL, NULL);
+        return pdFAIL;
+    }
+    tsHandle = handle;
+
+    tmrReg = TMR_getTMRPointer(handle);
+
+    //in 32bit mode the overflow flag is the one of the slave timer
+    ifsReg = Tmr_TimerMap[state->number].ifsReg;
+    intMask = Tmr_TimerMap[state->number].intMask;
+
+    tickFrequency_Hz = TMR_getCountFrequency_Hz(handle);
+    TTS_makeFactor(&nsFactor, 1000000000);
+    TTS_makeFactor(&usFactor, 1000000);
+    epochTicks = 0;
+    epochNs = 0;
+    epochUs = 0;
+
+    //run over the full 32bit range
+    TMR_setEnabled(handle, 0);
+    *tmrReg = 0;
+    TMR_claimPR(handle);
+    *TMR_getPRPointer(handle) = 0xffffffff;
+    TMR_clearIFS(handle);
+    overflowCount = 0;
+
+    TMR_setMode(handle, TmrMode_freeRunning);
+    TMR_setIRQEnabled(handle, 1);
+    TMR_setEnabled(handle, 1);
+
+    return pdPASS;
+}
+
+void TTS_deinit(){
+    if(tsHandle == NULL) return;
+
+    TMR_setIRQEnabled(tsHandle, 0);
+    TMR_setISR(tsHandle, NULL, NULL);
+    TMR_removeClockHook(TTS_clockHook);
+    tsHandle = NULL;
+}
+
+uint64_t TTS_getTicks(){
+    uint32_t before;
+    uint32_t after;
+    uint32_t low;
+    uint32_t pending;
+
+    do{
+        before = overflowCount;
+        low = *tmrReg;
+
+        //did the counter wrap without the isr running yet (because we are in a critical section or an isr ourself)?
+        //Only trust the flag for a low count, a high one means we read the counter before the wrap happened
+        pending = (ifsReg->w & intMask) && (low < 0x80000000);
+
+        after = overflowCount;
+
+    //if the isr ran in the meantime we can't know if low is from before or after the wrap, so just try again
+    }while(before != after);
+
+    return ((uint64_t) (before + pending) << 32) | low;
+}
+
+uint32_t TTS_getTickFrequency_Hz(){
+    return tickFrequency_Hz;
+}
+
+uint64_t TTS_ticksToNs(uint64_t ticks){
+    return TTS_convert(ticks, &nsFactor);
+}
+
+uint64_t TTS_ticksToUs(uint64_t ticks){
+    return TTS_convert(ticks, &usFactor);
+}
+
+uint64_t TTS_getNs(){
+    return epochNs + TTS_convert(TTS_getTicks() - epochTicks, &nsFactor);
+}
+
+uint64_t TTS_getUs(){
+    return epochUs + TTS_convert(TTS_getTicks() - epochTicks, &usFactor);
+}
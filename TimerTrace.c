@@ -0,0 +1,199 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef TMR_SIMULATION
+#include <xc.h>
+
+#if !__is_compiling || __has_include("FreeRTOS.h")
+#include "FreeRTOS.h"
+#endif
+#endif
+
+#include "Timer.h"
+#include "TimerConfig.h"
+#include "TimerTrace.h"
+
+#if TMR_ENABLE_REG_TRACE
+
+#if (TMR_TRACE_BUFFER_SIZE & (TMR_TRACE_BUFFER_SIZE - 1)) != 0
+    #error "TMR_TRACE_BUFFER_SIZE must be a power of two"
+#endif
+
+static TimerTraceRecord_t records[TMR_TRACE_BUFFER_SIZE];
+
+//total number of records ever written, the ring index is the lower bits
+static volatile uint32_t recordCount = 0;
+static volatile uint32_t logging = 1;
+
+static const char * volatile currentLabel = NULL;
+static volatile TimerTraceCounts_t callCounts;
+static volatile TimerTraceCounts_t totalCounts;
+
+static const char * portNames[4] = {"", "CLR", "SET", "INV"};
+//register names as in the datasheet, with the timer number filled in
+static const char * timerRegNames[3] = {"T%uCON", "TMR%u", "PR%u"};
+static const char * interruptRegNames[3] = {"IEC", "IFS", "IPC"};
+
+//finds out which register an address belongs to. Returns the port (0 for the register itself, then CLR, SET and INV) and the register the port writes to.
+//timer is only set for the timer registers, the interrupt registers are shared between timers
+static uint32_t Tmr_traceLocate(const volatile uint32_t * reg, uint32_t * timer, const char ** name, const volatile uint32_t ** base){
+    uintptr_t address = (uintptr_t) reg;
+    
+    for(uint32_t i = 0; i < TMR_NUM_TIMERS; i++){
+        const TimerDescriptor_t * desc = &Tmr_TimerMap[i];
+        
+        //every register is a group of 4 words: the register, CLR, SET and INV
+        uintptr_t map = (uintptr_t) desc->registerMap;
+        if(address >= map && address < map + sizeof(TmrMap_t)){
+            uint32_t word = (address - map) / sizeof(uint32_t);
+            *timer = i + 1;
+            *name = timerRegNames[word >> 2];
+            *base = (const volatile uint32_t *) desc->registerMap + (word & ~3);
+            return word & 3;
+        }
+        
+        const Pic32SetClearMap_t * maps[3] = {desc->iecReg, desc->ifsReg, desc->ipcReg};
+        for(uint32_t j = 0; j < 3; j++){
+            map = (uintptr_t) maps[j];
+            if(address < map || address >= map + sizeof(Pic32SetClearMap_t)) continue;
+            
+            *timer = 0;
+            *name = interruptRegNames[j];
+            *base = (const volatile uint32_t *) maps[j];
+            return (address - map) / sizeof(uint32_t);
+        }
+    }
+    
+    *timer = 0;
+    *name = "?";
+    *base = reg;
+    return 0;
+}
+
+static void Tmr_traceRecord(const volatile uint32_t * reg, uint32_t value, uint32_t type){
+    if(!logging) return;
+    
+    //claim the slot first, an interrupt tracing in between then gets the next one
+    uint32_t index = __sync_fetch_and_add(&recordCount, 1) & (TMR_TRACE_BUFFER_SIZE - 1);
+    records[index].label = currentLabel;
+    records[index].address = reg;
+    records[index].value = value;
+    records[index].type = type;
+}
+
+uint32_t Tmr_traceRead(const volatile uint32_t * reg){
+    uint32_t value = *reg;
+    
+    __sync_fetch_and_add(&callCounts.reads, 1);
+    __sync_fetch_and_add(&totalCounts.reads, 1);
+    Tmr_traceRecord(reg, value, TMR_TRACE_READ);
+    
+    return value;
+}
+
+void Tmr_traceWrite(volatile uint32_t * reg, uint32_t value){
+    uint32_t timer;
+    const char * name;
+    const volatile uint32_t * base;
+    uint32_t port = Tmr_traceLocate(reg, &timer, &name, &base);
+    
+    //would the write change anything? Reading the registers has no side effects, so we can just look
+    uint32_t current = *base;
+    uint32_t redundant;
+    switch(port){
+        case 1: redundant = (current & value) == 0; break;
+        case 2: redundant = (current & value) == value; break;
+        case 3: redundant = value == 0; break;
+        default: redundant = current == value; break;
+    }
+    
+    *reg = value;
+    
+#ifdef TMR_SIMULATION
+    //make the write visible right away, just like on the hardware
+    TMR_SIM_syncRegister(reg);
+#endif
+    
+    __sync_fetch_and_add(&callCounts.writes, 1);
+    __sync_fetch_and_add(&totalCounts.writes, 1);
+    if(redundant){
+        __sync_fetch_and_add(&callCounts.redundantWrites, 1);
+        __sync_fetch_and_add(&totalCounts.redundantWrites, 1);
+    }
+    
+    Tmr_traceRecord(reg, value, redundant ? TMR_TRACE_WRITE | TMR_TRACE_REDUNDANT : TMR_TRACE_WRITE);
+}
+
+void TMR_traceBegin(const char * label){
+    currentLabel = label;
+    callCounts.reads = 0;
+    callCounts.writes = 0;
+    callCounts.redundantWrites = 0;
+}
+
+void TMR_traceEnd(TimerTraceCounts_t * counts){
+    if(counts != NULL){
+        counts->reads = callCounts.reads;
+        counts->writes = callCounts.writes;
+        counts->redundantWrites = callCounts.redundantWrites;
+    }
+    
+    currentLabel = NULL;
+}
+
+void TMR_traceGetTotals(TimerTraceCounts_t * counts){
+    counts->reads = totalCounts.reads;
+    counts->writes = totalCounts.writes;
+    counts->redundantWrites = totalCounts.redundantWrites;
+}
+
+void TMR_traceSetLogging(uint32_t on){
+    logging = on;
+}
+
+void TMR_traceReset(){
+    recordCount = 0;
+    currentLabel = NULL;
+    callCounts.reads = 0;
+    callCounts.writes = 0;
+    callCounts.redundantWrites = 0;
+    totalCounts.reads = 0;
+    totalCounts.writes = 0;
+    totalCounts.redundantWrites = 0;
+}
+
+uint32_t TMR_traceGetRecords(TimerTraceRecord_t * out, uint32_t maxCount){
+    uint32_t end = recordCount;
+    uint32_t count = (end < TMR_TRACE_BUFFER_SIZE) ? end : TMR_TRACE_BUFFER_SIZE;
+    if(count > maxCount) count = maxCount;
+    
+    for(uint32_t i = 0; i < count; i++) out[i] = records[(end - count + i) & (TMR_TRACE_BUFFER_SIZE - 1)];
+    
+    return count;
+}
+
+void TMR_traceDump(TimerTracePrint_t print){
+    uint32_t end = recordCount;
+    uint32_t count = (end < TMR_TRACE_BUFFER_SIZE) ? end : TMR_TRACE_BUFFER_SIZE;
+    
+    for(uint32_t i = end - count; i != end; i++){
+        TimerTraceRecord_t * record = &records[i & (TMR_TRACE_BUFFER_SIZE - 1)];
+        
+        uint32_t timer;
+        const char * name;
+        const volatile uint32_t * base;
+        uint32_t port = Tmr_traceLocate(record->address, &timer, &name, &base);
+        
+        (*print)("%s: ", record->label ? record->label : "-");
+        (*print)(name, (unsigned) timer);
+        (*print)("%s ", portNames[port]);
+        
+        (*print)("%s 0x%08x%s\n", (record->type & TMR_TRACE_READ) ? "read" : "write", (unsigned) record->value, (record->type & TMR_TRACE_REDUNDANT) ? " redundant" : "");
+    }
+    
+    TimerTraceCounts_t totals;
+    TMR_traceGetTotals(&totals);
+    (*print)("total: %u reads, %u writes, %u redundant\n", (unsigned) totals.reads, (unsigned) totals.writes, (unsigned) totals.redundantWrites);
+}
+
+#endif
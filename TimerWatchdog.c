@@ -0,0 +1,234 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef TMR_SIMULATION
+#include <xc.h>
+
+#if !__is_compiling || __has_include("FreeRTOS.h")
+#include "FreeRTOS.h"
+#endif
+#endif
+
+#include "Timer.h"
+#include "TimerConfig.h"
+#include "TimerWatchdog.h"
+
+#if TWD_MAX_JOBS > 32
+    #error "TWD_MAX_JOBS can be at most 32, the armed jobs are kept in a 32bit mask"
+#endif
+
+static TimerWatchJob_t * volatile jobs[TWD_MAX_JOBS];
+
+//bit n is set while jobs[n] is running. Changed from tasks and the isr, always with atomic read-modify-writes
+static volatile uint32_t armedMask = 0;
+
+//slots in use, only changed inside TMR_ENTER_CRITICAL
+static uint32_t usedMask = 0;
+
+//time of the last period match, the current time is base + TMR
+static volatile uint32_t base = 0;
+
+static TimerHandle_t * wdHandle = NULL;
+static volatile uint32_t * tmrReg = NULL;
+static volatile uint32_t * prReg = NULL;
+static TimerMissHandler_t missHandler = NULL;
+static void * missData = NULL;
+
+//count rate the budgets of the registered jobs are in
+static uint32_t countFrequency_Hz = 0;
+
+static uint32_t TWD_isr(TimerHandle_t * handle, uint32_t flags, void * data){
+    base += *prReg + 1;
+    uint32_t now = base + *tmrReg;
+    
+    //only look at the jobs that are running
+    uint32_t armed = armedMask;
+    while(armed != 0){
+        uint32_t slot = __builtin_ctz(armed);
+        armed &= armed - 1;
+        
+        //the job may have been unregistered after we took the mask
+        TimerWatchJob_t * job = jobs[slot];
+        if(job == NULL || job->missed || (int32_t) (now - job->deadline) <= 0) continue;
+        
+        job->missed = 1;
+        if(missHandler != NULL) (*missHandler)(job, missData);
+    }
+    
+    return 0;
+}
+
+//the time base is built from PR, so it is claimed and a clock change by a power of two only keeps the count rate. Any other change leaves the timer
+//with a new rate, the budgets are scaled to it. Jobs that are running keep the deadline they started with
+static void TWD_clockHook(uint32_t oldClock_Hz, uint32_t newClock_Hz){
+    uint32_t frequency_Hz = TMR_getCountFrequency_Hz(wdHandle);
+    if(frequency_Hz == 0 || frequency_Hz == countFrequency_Hz) return;
+    
+    TMR_ENTER_CRITICAL();
+    for(uint32_t slot = 0; slot < TWD_MAX_JOBS; slot++){
+        TimerWatchJob_t * job = jobs[slot];
+        if(job != NULL) job->budget = ((uint64_t) job->budget * frequency_Hz + (countFrequency_Hz >> 1)) / countFrequency_Hz;
+    }
+    countFrequency_Hz = frequency_Hz;
+    TMR_EXIT_CRITICAL();
+}
+
+uint32_t TWD_init(TimerHandle_t * handle, TimerMissHandler_t handler, void * data){
+    if(!TMR_isHandleAllocated(handle) || wdHandle != NULL) return pdFAIL;
+    
+    if(!TMR_setISR(handle, TWD_isr, NULL)) return pdFAIL;
+    if(!TMR_addClockHook(TWD_clockHook)){
+        TMR_setISR(handle, NULL, NULL);
+        return pdFAIL;
+    }
+    wdHandle = handle;
+    
+    tmrReg = TMR_getTMRPointer(handle);
+    prReg = TMR_getPRPointer(handle);
+    TMR_claimPR(handle);
+    countFrequency_Hz = TMR_getCountFrequency_Hz(handle);
+    missHandler = handler;
+    missData = data;
+    base = 0;
+    
+    TMR_setEnabled(handle, 0);
+    *tmrReg = 0;
+    TMR_clearIFS(handle);
+    
+    TMR_setMode(handle, TmrMode_freeRunning);
+    TMR_setIRQEnabled(handle, 1);
+    TMR_setEnabled(handle, 1);
+    
+    return pdPASS;
+}
+
+void TWD_deinit(){
+    if(wdHandle == NULL) return;
+    
+    TMR_setIRQEnabled(wdHandle, 0);
+    TMR_setISR(wdHandle, NULL, NULL);
+    TMR_removeClockHook(TWD_clockHook);
+    wdHandle = NULL;
+    tmrReg = NULL;
+    prReg = NULL;
+    
+    //the time base starts over at the next TWD_init, deadlines of running jobs mean nothing there
+    armedMask = 0;
+}
+
+uint32_t TWD_now(){
+    if(wdHandle == NULL) return 0;
+    
+    uint32_t before;
+    uint32_t count;
+    uint32_t pending;
+    
+    do{
+        before = base;
+        count = *tmrReg;
+        
+        //did the period end without the isr running yet? A low count means the counter already restarted
+        pending = TMR_readIFS(wdHandle) && (count < (*prReg >> 1));
+    }while(before != base);
+    
+    return before + count + (pending ? *prReg + 1 : 0);
+}
+
+uint32_t TWD_usToCounts(uint32_t us){
+    return ((uint64_t) countFrequency_Hz * us) / 1000000;
+}
+
+//a job is only registered if its slot points back at it. That also catches a job whose slot was never initialised
+static inline uint32_t TWD_isRegistered(TimerWatchJob_t * job){
+    return job->slot < TWD_MAX_JOBS && jobs[job->slot] == job;
+}
+
+uint32_t TWD_register(TimerWatchJob_t * job, uint32_t budget){
+    if(TWD_isRegistered(job)) return pdFAIL;
+    
+    job->budget = budget;
+    job->missed = 0;
+    TWD_resetStats(job);
+    
+    //two tasks registering at the same time must not get the same slot
+    TMR_ENTER_CRITICAL();
+    uint32_t free = ~usedMask;
+    if(TWD_MAX_JOBS < 32) free &= (1ul << TWD_MAX_JOBS) - 1;
+    if(free == 0){
+        TMR_EXIT_CRITICAL();
+        job->slot = TWD_NOT_REGISTERED;
+        return pdFAIL;
+    }
+    
+    uint32_t slot = __builtin_ctz(free);
+    usedMask |= 1ul << slot;
+    job->slot = slot;
+    jobs[slot] = job;
+    TMR_EXIT_CRITICAL();
+    
+    return pdPASS;
+}
+
+void TWD_unregister(TimerWatchJob_t * job){
+    if(!TWD_isRegistered(job)) return;
+    
+    uint32_t slot = job->slot;
+    __sync_fetch_and_and(&armedMask, ~(1ul << slot));
+    
+    TMR_ENTER_CRITICAL();
+    jobs[slot] = NULL;
+    usedMask &= ~(1ul << slot);
+    TMR_EXIT_CRITICAL();
+    
+    job->slot = TWD_NOT_REGISTERED;
+}
+
+void TWD_startBy(TimerWatchJob_t * job, uint32_t deadline){
+    if(wdHandle == NULL || !TWD_isRegistered(job)) return;
+    
+    job->start = TWD_now();
+    job->deadline = deadline;
+    job->missed = 0;
+    
+    //the job must be set up before the isr can see it armed
+    __sync_fetch_and_or(&armedMask, 1ul << job->slot);
+}
+
+void TWD_start(TimerWatchJob_t * job){
+    if(wdHandle == NULL || !TWD_isRegistered(job)) return;
+    
+    uint32_t now = TWD_now();
+    
+    job->start = now;
+    job->deadline = now + job->budget;
+    job->missed = 0;
+    
+    __sync_fetch_and_or(&armedMask, 1ul << job->slot);
+}
+
+uint32_t TWD_complete(TimerWatchJob_t * job){
+    if(wdHandle == NULL || !TWD_isRegistered(job)) return 0;
+    
+    uint32_t now = TWD_now();
+    __sync_fetch_and_and(&armedMask, ~(1ul << job->slot));
+    
+    uint32_t executionTime = now - job->start;
+    job->lastExecutionTime = executionTime;
+    if(executionTime > job->wcet) job->wcet = executionTime;
+    job->runs++;
+    
+    //the isr might not have scanned since the deadline passed, so check here too
+    if(job->missed || (int32_t) (now - job->deadline) > 0){
+        job->misses++;
+        return 0;
+    }
+    
+    return 1;
+}
+
+void TWD_resetStats(TimerWatchJob_t * job){
+    job->runs = 0;
+    job->misses = 0;
+    job->wcet = 0;
+    job->lastExecutionTime = 0;
+}
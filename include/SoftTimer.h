@@ -0,0 +1,80 @@
+#ifndef SoftTimer_INC
+#define SoftTimer_INC
+
+/*
+* Software timers for the Pic32Timer Library
+*
+* Multiplexes any number of software timers onto a single hardware timer using a hierarchical timing wheel.
+* Starting, stopping and expiring a timer are all O(1) and nothing is ever allocated, the timer nodes are embedded in the callers memory.
+*
+* All times are in ticks of the hardware timer passed to STMR_init, its period has to be configured by the caller.
+*/
+
+#include <stdint.h>
+
+#include "Timer.h"
+
+//number of slots per wheel level as a power of two
+#ifndef STMR_SLOT_BITS
+#define STMR_SLOT_BITS 6
+#endif
+
+//number of wheel levels. The maximum timeout is 2^(STMR_SLOT_BITS * STMR_LEVELS) - 1 ticks, longer ones get re-cascaded until they expire
+#ifndef STMR_LEVELS
+#define STMR_LEVELS 4
+#endif
+
+#define STMR_SLOTS (1 << STMR_SLOT_BITS)
+
+typedef struct SoftTimer_s SoftTimer_t;
+
+//prototype of the function called when a software timer expires. It runs in the interrupt of the hardware timer
+typedef void (*SoftTimerCallback_t)(SoftTimer_t * timer, void * data);
+
+//list links, also used as the heads of the wheel slots
+typedef struct SoftTimerLink_s{
+    struct SoftTimerLink_s * next;
+    struct SoftTimerLink_s * prev;
+} SoftTimerLink_t;
+
+//software timer node. Must stay valid for as long as the timer is running
+struct SoftTimer_s{
+    SoftTimerLink_t link;
+
+    uint32_t expiry;
+    uint32_t period;
+
+    SoftTimerCallback_t callback;
+    void * data;
+};
+
+//attaches the wheel to an allocated hardware timer. Its period must already be set, every interrupt advances the wheel by one tick
+uint32_t STMR_init(TimerHandle_t * handle);
+
+//detaches the wheel from its hardware timer. Running software timers are not called anymore
+void STMR_deinit();
+
+//prepares a timer node for use
+void STMR_initTimer(SoftTimer_t * timer, SoftTimerCallback_t callback, void * data);
+
+//(re-)starts a timer to expire in delay_ticks. If period_ticks is not 0 the timer is re-armed automatically every period_ticks after that
+void STMR_start(SoftTimer_t * timer, uint32_t delay_ticks, uint32_t period_ticks);
+
+//(re-)starts a timer to expire at an absolute tick count. Deadlines that already passed expire on the next tick. The start functions do nothing while the wheel isn't attached
+void STMR_startAt(SoftTimer_t * timer, uint32_t deadline, uint32_t period_ticks);
+
+//re-arms a timer to expire delay_ticks after its last expiry instead of after now, so repeated re-arming doesn't accumulate drift
+void STMR_rearm(SoftTimer_t * timer, uint32_t delay_ticks);
+
+//stops a timer. Does nothing if it isn't running
+void STMR_stop(SoftTimer_t * timer);
+
+uint32_t STMR_isActive(SoftTimer_t * timer);
+
+//returns the current tick count of the wheel
+uint32_t STMR_getTicks();
+
+//advances the wheel by one tick and calls all expired timers. Called from the hardware timer interrupt
+void STMR_tick();
+
+#endif
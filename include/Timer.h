@@ -2,9 +2,13 @@
 #define Timer_INC 
 
 #include <stdint.h>
-#include <xc.h>
 
+#ifdef TMR_SIMULATION
+#include "TimerSim.h"
+#else
+#include <xc.h>
 #include "System.h"
+#endif
 
 #if __is_compiling && !__has_include("TimerConfig.h")
 	#error "No timer config file found in project!"
@@ -50,10 +54,29 @@ typedef union{
 		uint32_t TYPEB_TCKPS:3;
 	};
 	struct {
-		uint32_t w:32;
+		uint32_t w;
 	};
 } TConMap_t;
 
+//what TimerState_t.request holds
+#define TMR_REQUEST_NONE 0
+#define TMR_REQUEST_PERIOD_US 1
+#define TMR_REQUEST_FREQUENCY_mHz 2
+
+//masks of the single bit settings in TCON
+#define TMR_TCS_MASK 0x00000002
+#define TMR_TSYNC_MASK 0x00000004
+#define TMR_T32_MASK 0x00000008
+#define TMR_TGATE_MASK 0x00000080
+
+//the 5 priority and sub priority bits of an interrupt in its IPC register
+#define TMR_PRIORITY_MASK 0x0000001f
+
+//position and masks of the prescaler bits in TCON
+#define TMR_TCKPS_POSITION 4
+#define TMR_TYPEA_TCKPS_MASK 0x00000030
+#define TMR_TYPEB_TCKPS_MASK 0x00000070
+
 //Timer register map, also identical for Type A and Type B
 typedef struct{
 	TConMap_t TCON;
@@ -88,25 +111,160 @@ typedef struct{
 	uint32_t interruptVector;
 } TimerDescriptor_t;
 
-//Handle for the timer given to the user as a reference.
+//handle of an allocated timer, given to the user as a reference. The type is opaque and the pointer is never dereferenced: it holds the timer number
+//and the generation of the allocation, so a copy that outlived TMR_deinit is rejected by every call, even after the timer was allocated again.
+//The fields of the timer are in TimerState_t, see TMR_getState
+typedef struct TimerHandle_s TimerHandle_t;
+
+#define TMR_INVALID_HANDLE ((TimerHandle_t *) 0)
+#define TMR_HANDLE_NUMBER_MASK 0x000000ff
+#define TMR_HANDLE_GENERATION_MASK 0xffffff00
+#define TMR_HANDLE_GENERATION_POSITION 8
+
+//state of an allocated timer, kept by the library
 typedef struct{
-	TimerDescriptor_t * descriptor;
+	const TimerDescriptor_t * descriptor;
     
     TimerMode_t currentMode;
 	uint32_t number;
 	uint32_t flags;
-} TimerHandle_t;
+    
+    //the handle this state was allocated for
+    TimerHandle_t * self;
+    
+    //images of TCON and of the interrupt priority bits as last written by the driver, used to change them with single writes.
+    //TCON is also changed from TMR_isrHandler, so its shadow is only ever updated with atomic set/clear operations
+    volatile uint32_t tconShadow;
+    uint32_t priorityShadow;
+    
+    //period or frequency last set with TMR_setPeriod or TMR_setFrequency, kept up on clock changes
+    uint32_t request;
+    uint32_t requestValue;
+} TimerState_t;
+
+//what a timer allocated with Tmr_initAny must be able to do. Fields left at 0 don't restrict the choice
+typedef struct{
+    //range of periods the timer must be able to reach with a single prescaler setting
+    uint32_t minPeriod_us;
+    uint32_t maxPeriod_us;
+    
+    //longest allowed timer count at that prescaler setting
+    uint32_t resolution_ns;
+    
+    uint32_t need32Bit;
+    
+    //count an external clock asynchronously, so the timer keeps running in sleep. Synchronous external clock and gated counting work on every timer
+    uint32_t needAsyncClock;
+    
+    //interrupt priority the timer will use (1-7). The timer must have a usable isr and gets this priority set
+    uint32_t irqPriority;
+} TimerRequirements_t;
+
+//complete timer setup for TMR_configure
+typedef struct{
+    uint32_t clockSource;
+    uint32_t gate;
+    uint32_t sync;
+    uint32_t prescaler;
+    uint32_t prValue;
+    
+    TimerMode_t mode;
+    uint32_t priority;
+    uint32_t subPriority;
+    
+    uint32_t irqEnabled;
+    uint32_t enabled;
+} TimerSetup_t;
+
+
+//result of the rate solver
+typedef struct{
+    uint32_t prescaler;
+    uint32_t prValue;
+    uint32_t Frequency_mHz;
+    int32_t error_ppm;
+} TmrRateSolution_t;
+
+//number of power of two buckets in the isr statistics histograms. Bucket n counts values from 2^(n-1) to 2^n - 1, the last one everything above
+#define TMR_STATS_BUCKETS 16
+
+//statistics of one measured quantity, all values in peripheral clock cycles
+typedef struct{
+    uint32_t min;
+    uint32_t max;
+    uint32_t mean;
+    uint32_t count;
+    uint64_t sum;
+    uint32_t histogram[TMR_STATS_BUCKETS];
+} TimerStat_t;
+
+//isr statistics of a timer. Only collected if TMR_ENABLE_ISR_STATS is set in TimerConfig.h
+typedef struct{
+    //time from the period match to the isr entry
+    TimerStat_t latency;
+    //change of the latency from one interrupt to the next
+    TimerStat_t jitter;
+    //time the callback assigned with TMR_setISR took
+    TimerStat_t duration;
+    
+    uint32_t lastLatency;
+} TimerIsrStats_t;
 
 //prototype of a function that can be used as an intterupt service routine
 typedef uint32_t (*TimerISR_t)(TimerHandle_t * handle, uint32_t flags, void* data);
 
+//callback of a timer interrupt together with its data. Always changed as a whole
+typedef struct{
+    TimerISR_t function;
+    void * data;
+} TimerIsrBinding_t;
 
-//allocates a specified timer
+//called by TMR_notifyClockChange once every timer has its new settings, for everything that keeps rates of its own derived from the clock
+typedef void (*TimerClockHook_t)(uint32_t oldClock_Hz, uint32_t newClock_Hz);
+
+//number of functions that can be registered with TMR_addClockHook at the same time
+#ifndef TMR_MAX_CLOCK_HOOKS
+#define TMR_MAX_CLOCK_HOOKS 8
+#endif
+
+//flags passed to the callbacks of a period sequence
+#define TMR_SEQ_FLAG_STEP 0x00000001
+#define TMR_SEQ_FLAG_HALF 0x00000002
+#define TMR_SEQ_FLAG_COMPLETE 0x00000004
+
+typedef enum {TmrSeqMode_OneShot, TmrSeqMode_Loop} TimerSequenceMode_t;
+
+//list of PR values the timer plays back, one per period
+typedef struct{
+    const uint32_t * prValues;
+    //optional, one callback per step (entries may be NULL). Called with TMR_SEQ_FLAG_STEP at the end of the step
+    const TimerISR_t * stepCallbacks;
+    uint32_t length;
+    
+    TimerSequenceMode_t mode;
+    
+    //optional, called with TMR_SEQ_FLAG_HALF once the first half of prValues was used and with TMR_SEQ_FLAG_COMPLETE once the second half was.
+    //The half that was just used can then be refilled while the other one plays, so long sequences can be streamed through a ping-pong buffer
+    TimerISR_t notify;
+    void * data;
+} TimerSequence_t;
+
+
+//allocates a specified timer. Returns TMR_INVALID_HANDLE if it is taken or doesn't exist
 TimerHandle_t * Tmr_init(uint32_t timerNumber, uint32_t enable32BitMode);
 
-//frees a timer
+//allocates the best free timer that meets the requirements, preferring the least capable one. Returns TMR_INVALID_HANDLE if there is none
+TimerHandle_t * Tmr_initAny(const TimerRequirements_t * requirements);
+
+//frees a timer, its callback is removed so the next allocation starts without one
 void TMR_deinit(TimerHandle_t * handle);
 
+//checks if a handle is still the allocation it was returned for. Every call does this check itself and ignores stale handles
+uint32_t TMR_isHandleAllocated(TimerHandle_t * handle);
+
+//state behind a handle for modules built on the driver, NULL if the handle is stale
+TimerState_t * TMR_getState(TimerHandle_t * handle);
+
 
 
 //set timer mode
@@ -119,20 +277,70 @@ void TMR_setEnabled(TimerHandle_t * handle, uint32_t enabled);
 //switch the timer on or off
 uint32_t TMR_isEnabled(TimerHandle_t * handle);
 
+//applies clock source, prescaler, PR, mode, priority, interrupt and on state in one go with as few register writes as possible. A running timer
+//is stopped while PR changes and started again with the rest of the new configuration, so the hardware never sees a half configured timer
+void TMR_configure(TimerHandle_t * handle, const TimerSetup_t * setup);
+
 
 //set the desired period of the timer. Returns 1 on success or 0 if the desired period could not be achieved
 uint32_t TMR_setPeriod(TimerHandle_t * handle, uint32_t period_us);
 
 uint32_t TMR_getPeriod_us(TimerHandle_t * handle);
 
+//set the desired frequency of the timer in mHz. Picks the prescaler with the smallest error and returns the frequency that was actually set, or 0 if the requested one could not be achieved
 uint32_t TMR_setFrequency(TimerHandle_t * handle, uint32_t Frequency_mHz);
 uint32_t TMR_getFrequency_mHz(TimerHandle_t * handle);
 
+//returns the rate the counter register counts at, so the peripheral clock after the prescaler
+//peripheral bus clock the timers currently run from. Starts at TMR_CLK_Hz
+uint32_t TMR_getClock_Hz();
+
+//tells the library the peripheral bus clock changed. Timers set with TMR_setPeriod or TMR_setFrequency get new settings for the same period,
+//running ones with their interrupt on switch over at their next period match. All others keep their count rate with a new prescaler if the clock
+//changed by a power of two, their PR isn't touched.
+//The functions registered with TMR_addClockHook are called last.
+//TimerConst.h and TimerFast.h are resolved at compile time and always assume TMR_CLK_Hz
+void TMR_notifyClockChange(uint32_t newClock_Hz);
 
+//registers a function to be called at every clock change. Adding one that is already registered does nothing, fails if all TMR_MAX_CLOCK_HOOKS slots are taken
+uint32_t TMR_addClockHook(TimerClockHook_t hook);
+void TMR_removeClockHook(TimerClockHook_t hook);
+
+uint32_t TMR_getCountFrequency_Hz(TimerHandle_t * handle);
+
+//calculates prescaler and PR for a frequency without touching the timer. Returns the frequency that would be reached and its error in ppm (error_ppm may be NULL)
+uint32_t TMR_calculateFrequency(TimerHandle_t * handle, uint32_t Frequency_mHz, uint32_t * prescaler, uint32_t * prValue, int32_t * error_ppm);
+
+
+//sets the prescaler (TCKPS value) and the number of counts per period (PR + 1) directly. Returns 1 on success or 0 if either is out of range.
+//A running timer is stopped while both change, and a clock change afterwards keeps the count rate rather than an earlier period or frequency
 uint32_t TMR_setCustomDivider(TimerHandle_t * handle, uint32_t preScaler, uint32_t divider);
 
+//finds the prescaler and PR that get closest to a frequency for a timer type, including 32bit pairs. Returns the achieved frequency (0 if unreachable). Results are cached
+uint32_t TMR_findClosestRate(TimerType_t type, uint32_t is32Bit, uint32_t Frequency_mHz, TmrRateSolution_t * solution);
+
+//buffered period updates. Each queued prescaler/PR pair is applied by TMR_isrHandler at the next period match, one per match, so the current period
+//always runs to its end. The timer interrupt must be enabled for this to work. Only available if TMR_PERIOD_QUEUE_SIZE in TimerConfig.h is not 0
+uint32_t TMR_queuePrescalerAndPR(TimerHandle_t * handle, uint32_t scaler, uint32_t prValue);
+uint32_t TMR_queueFrequency(TimerHandle_t * handle, uint32_t Frequency_mHz);
+uint32_t TMR_getQueuedUpdateCount(TimerHandle_t * handle);
+void TMR_flushPeriodQueue(TimerHandle_t * handle);
+
+//plays back a period sequence from TMR_isrHandler, starting the timer with the first step. In one shot mode the timer stops at the end of the last step.
+//The sequence description is copied but prValues and stepCallbacks are used in place. Only available if TMR_ENABLE_SEQUENCER in TimerConfig.h is set.
+//PR is claimed (see TMR_claimPR) while the sequence runs and handed back to the period or frequency set before it once the sequence ends or is stopped
+uint32_t TMR_startSequence(TimerHandle_t * handle, const TimerSequence_t * sequence);
+void TMR_stopSequence(TimerHandle_t * handle);
+uint32_t TMR_isSequenceRunning(TimerHandle_t * handle);
+
+//index of the step that is currently running
+uint32_t TMR_getSequencePosition(TimerHandle_t * handle);
+
 void TMR_setPrescaler(TimerHandle_t * handle, uint32_t scaler);
 
+//sets prescaler and PR together with as few register accesses as possible. Used with the precomputed values from TimerConst.h
+void TMR_setPrescalerAndPR(TimerHandle_t * handle, uint32_t scaler, uint32_t prValue);
+
 uint32_t TMR_getCount(TimerHandle_t * handle);
 
 uint32_t TMR_calculatePR(TimerHandle_t * handle, uint32_t period_us, uint32_t divider);
@@ -146,6 +354,11 @@ uint32_t TMR_isIRQEnabled(TimerHandle_t * handle);
 
 uint32_t TMR_setISR(TimerHandle_t * handle, TimerISR_t isr, void * data);
 
+//replaces the callback of a timer in one step and returns the one that was set before. The interrupt stays enabled and always sees either the old or the new binding complete.
+//Rebinding a timer from several places at once (for example from a task and an interrupt) must be prevented by the caller
+TimerIsrBinding_t TMR_swapISR(TimerHandle_t * handle, TimerISR_t isr, void * data);
+TimerIsrBinding_t TMR_getISR(TimerHandle_t * handle);
+
 void TMR_setInterruptPriority(TimerHandle_t * handle, uint32_t priority, uint32_t subPriority);
 
 void TMR_setClockSource(TimerHandle_t * handle, uint32_t source, uint32_t gate, uint32_t sync);
@@ -154,12 +367,34 @@ uint32_t TMR_readIFS(TimerHandle_t * handle);
 
 void TMR_clearIFS(TimerHandle_t * handle);
 
+//sets the interrupt flag by software, the isr then runs just like after a period match
+void TMR_triggerIRQ(TimerHandle_t * handle);
+
 //functions to get pointers to the timer counter and compare registers
 uint32_t * TMR_getPRPointer(TimerHandle_t * handle);
 uint32_t * TMR_getTMRPointer(TimerHandle_t * handle);
+
+//tells the driver that PR is written through the pointer from now on, usually from the timer's isr. TMR_notifyClockChange then only
+//changes the prescaler and never writes PR. Setting a period or frequency with the driver hands PR back to it
+void TMR_claimPR(TimerHandle_t * handle);
 uint32_t TMR_getInterruptNumber(TimerHandle_t * handle);
 uint32_t TMR_getInterruptVector(TimerHandle_t * handle);
 
 void TMR_isrHandler(uint32_t timerIndex);
+
+//isr statistics, only available if TMR_ENABLE_ISR_STATS is set in TimerConfig.h. Get copies the current values (with the mean filled in), reset clears them
+uint32_t TMR_getIsrStats(TimerHandle_t * handle, TimerIsrStats_t * stats);
+void TMR_resetIsrStats(TimerHandle_t * handle);
+
+//counter value sampled on isr entry and the counter register to sample for each isr, used by TMR_ISR_ENTRY. Only defined with TMR_ENABLE_ISR_STATS set
+extern volatile uint32_t Tmr_isrEntryCount[];
+extern volatile uint32_t * volatile Tmr_isrCountRegister[];
+
+//called first thing in the generated ISRs. Samples the counter for the isr statistics, or compiles to nothing if TMR_ENABLE_ISR_STATS isn't set
+#define TMR_ISR_ENTRY(index) TMR_ISR_ENTRY_SELECT(TMR_ENABLE_ISR_STATS, index)
+#define TMR_ISR_ENTRY_SELECT(enabled, index) TMR_ISR_ENTRY_SELECT_(enabled, index)
+#define TMR_ISR_ENTRY_SELECT_(enabled, index) TMR_ISR_ENTRY_##enabled(index)
+#define TMR_ISR_ENTRY_0(index)
+#define TMR_ISR_ENTRY_1(index) Tmr_isrEntryCount[index] = *Tmr_isrCountRegister[index]
  
 #endif 
@@ -14,6 +14,9 @@
 //define the number of timers available on your device here.
 #define TMR_NUM_TIMERS 5
 
+//set to 1 to allocate timer handles from a static pool instead of the heap. TMR_MALLOC and TMR_FREE are then never called
+#define TMR_USE_HANDLE_POOL 1
+
 //define the memory allocation and free functions to be used by the library here
 #define TMR_MALLOC(X) pvPortMalloc(X)
 #define TMR_FREE(X) vPortFree(X)
@@ -21,6 +24,34 @@
 //define the frequency of the bus the timers are running from
 #define TMR_CLK_Hz configPERIPHERAL_CLOCK_HZ
 
+//used where a short sequence of register writes must not be interrupted
+#define TMR_ENTER_CRITICAL() taskENTER_CRITICAL()
+#define TMR_EXIT_CRITICAL() taskEXIT_CRITICAL()
+
+//peripheral clocks between two consecutive TCON writes in the timer group start loop. Depends on the PBDIV setting, measure it by starting a group with no phase offsets and comparing the counters
+#ifndef TMR_GROUP_WRITE_SKEW_CYCLES
+#define TMR_GROUP_WRITE_SKEW_CYCLES 2
+#endif
+
+//set to 1 to collect latency, jitter and callback duration statistics in every timer isr. 0 compiles all of it out
+#ifndef TMR_ENABLE_ISR_STATS
+#define TMR_ENABLE_ISR_STATS 0
+#endif
+
+//set to 1 to count and log every register access of the driver (see TimerTrace.h). 0 compiles the accesses back to plain loads and stores
+#ifndef TMR_ENABLE_REG_TRACE
+#define TMR_ENABLE_REG_TRACE 0
+#endif
+
+//number of rate solver results to keep around. Each entry costs 24 bytes of ram
+#define TMR_RATE_CACHE_SIZE 8
+
+//number of buffered period updates that can be queued per timer with TMR_queuePrescalerAndPR. Must be a power of two, 0 compiles the queue out
+#define TMR_PERIOD_QUEUE_SIZE 4
+
+//set to 1 to include the period sequencer (TMR_startSequence). 0 removes it from the isr path
+#define TMR_ENABLE_SEQUENCER 1
+
 //this array contains a list of timers with their base addresses aswell as their types. It must be initialised in the corresponding .c file.
 extern const TimerDescriptor_t Tmr_TimerMap[];
 
@@ -0,0 +1,70 @@
+#ifndef TimerConst_INC
+#define TimerConst_INC
+
+/*
+* Compile time timer configuration for the Pic32Timer Library
+*
+* Resolves the prescaler and PR value for a constant period or frequency entirely in the preprocessor/compiler, so fixed rate timers never need
+* the 64bit arithmetic of TMR_setPeriod at runtime. A period that can't be reached with the given timer type fails the build.
+*
+* Usage:
+*   static const TmrConstConfig_t tick1k = TMR_CONST_FREQUENCY_mHz(TmrType_B_Master, 0, 1000000);
+*   TMR_applyConstConfig(handle, tick1k);
+*/
+
+#include <stdint.h>
+
+#include "Timer.h"
+#include "TimerConfig.h"
+
+//precomputed prescaler (TCKPS value) and PR pair
+typedef struct{
+    uint32_t prescaler;
+    uint32_t pr;
+} TmrConstConfig_t;
+
+//number of peripheral clock cycles in one period, rounded to the nearest cycle
+#define TMR_CONST_CYCLES_NS(period_ns) (((uint64_t) TMR_CLK_Hz * (uint64_t) (period_ns) + 500000000ull) / 1000000000ull)
+#define TMR_CONST_CYCLES_mHz(frequency_mHz) (((uint64_t) TMR_CLK_Hz * 1000ull + ((uint64_t) (frequency_mHz) / 2)) / (uint64_t) (frequency_mHz))
+
+//number of counts the timer can do in one period. 32bit mode is only available on type B master timers
+#define TMR_CONST_MAX_COUNT(type, is32Bit) (((type) == TmrType_B_Master && (is32Bit)) ? 0x100000000ull : 0x10000ull)
+
+//does a period of cycles fit into the counter with a prescaler of 2^shift?
+#define TMR_CONST_FITS(cycles, shift, maxCount) ((((cycles) + ((1ull << (shift)) >> 1)) >> (shift)) <= (maxCount))
+
+//smallest prescaler that can reach the period. Returns one past the last valid index if none can
+#define TMR_CONST_PRESCALER_A(cycles, maxCount) \
+    (TMR_CONST_FITS(cycles, 0, maxCount) ? 0 : TMR_CONST_FITS(cycles, 3, maxCount) ? 1 : TMR_CONST_FITS(cycles, 6, maxCount) ? 2 : TMR_CONST_FITS(cycles, 8, maxCount) ? 3 : 4)
+
+#define TMR_CONST_PRESCALER_B(cycles, maxCount) \
+    (TMR_CONST_FITS(cycles, 0, maxCount) ? 0 : TMR_CONST_FITS(cycles, 1, maxCount) ? 1 : TMR_CONST_FITS(cycles, 2, maxCount) ? 2 : TMR_CONST_FITS(cycles, 3, maxCount) ? 3 : \
+     TMR_CONST_FITS(cycles, 4, maxCount) ? 4 : TMR_CONST_FITS(cycles, 5, maxCount) ? 5 : TMR_CONST_FITS(cycles, 6, maxCount) ? 6 : TMR_CONST_FITS(cycles, 8, maxCount) ? 7 : 8)
+
+#define TMR_CONST_PRESCALER(type, cycles, maxCount) (((type) == TmrType_A) ? TMR_CONST_PRESCALER_A(cycles, maxCount) : TMR_CONST_PRESCALER_B(cycles, maxCount))
+
+//same mapping from TCKPS to the divider shift as the prescaler tables in Timer.c
+#define TMR_CONST_SHIFT(type, prescaler) \
+    (((type) == TmrType_A) ? (((prescaler) == 0) ? 0 : ((prescaler) == 1) ? 3 : ((prescaler) == 2) ? 6 : 8) : (((prescaler) == 7) ? 8 : (prescaler)))
+
+#define TMR_CONST_IS_VALID(type, cycles, maxCount) ((cycles) >= 2 && TMR_CONST_PRESCALER(type, cycles, maxCount) < (((type) == TmrType_A) ? 4 : 8))
+
+//evaluates to 0 if the condition holds, otherwise the negative array size stops the build
+#define TMR_CONST_ASSERT(condition) (0 * sizeof(char[(condition) ? 1 : -1]))
+
+#define TMR_CONST_FROM_CYCLES(type, is32Bit, cycles) \
+    { \
+        .prescaler = TMR_CONST_PRESCALER(type, cycles, TMR_CONST_MAX_COUNT(type, is32Bit)) + TMR_CONST_ASSERT(TMR_CONST_IS_VALID(type, cycles, TMR_CONST_MAX_COUNT(type, is32Bit))), \
+        .pr = (uint32_t) ((((cycles) + ((1ull << TMR_CONST_SHIFT(type, TMR_CONST_PRESCALER(type, cycles, TMR_CONST_MAX_COUNT(type, is32Bit)))) >> 1)) \
+                >> TMR_CONST_SHIFT(type, TMR_CONST_PRESCALER(type, cycles, TMR_CONST_MAX_COUNT(type, is32Bit)))) - 1) \
+    }
+
+//initialisers for a TmrConstConfig_t. type is one of the TimerType_t values, is32Bit must match the mode the timer was opened in
+#define TMR_CONST_PERIOD_NS(type, is32Bit, period_ns) TMR_CONST_FROM_CYCLES(type, is32Bit, TMR_CONST_CYCLES_NS(period_ns))
+#define TMR_CONST_PERIOD_US(type, is32Bit, period_us) TMR_CONST_PERIOD_NS(type, is32Bit, (uint64_t) (period_us) * 1000ull)
+#define TMR_CONST_FREQUENCY_mHz(type, is32Bit, frequency_mHz) TMR_CONST_FROM_CYCLES(type, is32Bit, TMR_CONST_CYCLES_mHz(frequency_mHz))
+
+//applies a precomputed configuration
+#define TMR_applyConstConfig(handle, config) TMR_setPrescalerAndPR(handle, (config).prescaler, (config).pr)
+
+#endif
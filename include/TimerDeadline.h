@@ -0,0 +1,85 @@
+#ifndef TimerDeadline_INC
+#define TimerDeadline_INC
+
+/*
+* Tickless deadline scheduler for the Pic32Timer Library
+*
+* Runs a 32bit timer pair (opened with Tmr_init(n, 1)) in single shot mode and programs PR so the next interrupt happens exactly at the earliest pending deadline.
+* The timer only interrupts when something is due (or once every 2^32 ticks to extend the time base to 64bit).
+*
+* Pending deadlines live in a fixed size min-heap, nothing is allocated. All times are in ticks of the timer, so the resolution is set by the prescaler the caller configured.
+*
+* Every deadline can have some slack, it may then fire anywhere between its deadline and deadline + slack. The timer is programmed to the earliest
+* of those latest times, and everything that is due by then fires in the same interrupt. Deadlines that don't set any slack fire exactly on time as before.
+*/
+
+#include <stdint.h>
+
+#include "Timer.h"
+
+//maximum number of deadlines that can be pending at the same time
+#ifndef TDL_MAX_DEADLINES
+#define TDL_MAX_DEADLINES 32
+#endif
+
+//minimum number of ticks between now and the next programmed match. Must cover the time it takes to reprogram PR, closer deadlines will fire up to this late
+#ifndef TDL_MIN_LEAD_TICKS
+#define TDL_MIN_LEAD_TICKS 16
+#endif
+
+#define TDL_NOT_QUEUED 0xffffffff
+
+typedef struct TimerDeadline_s TimerDeadline_t;
+
+//prototype of the function called when a deadline is reached. It runs in the timer interrupt
+typedef void (*TimerDeadlineCallback_t)(TimerDeadline_t * deadline, void * data);
+
+//deadline node, must stay valid while it is queued
+struct TimerDeadline_s{
+    uint64_t deadline;
+    uint32_t slack;
+    uint32_t heapIndex;
+
+    TimerDeadlineCallback_t callback;
+    void * data;
+};
+
+//coalescing statistics
+typedef struct{
+    //timer interrupts, including the ones that only extend the time base
+    uint32_t interrupts;
+    //deadline callbacks run
+    uint32_t expiries;
+    //interrupts saved by handling several expiries in one
+    uint32_t coalesced;
+} TimerDeadlineStats_t;
+
+//attaches the scheduler to a 32bit timer pair. The prescaler must already be set, the counter gets reset
+uint32_t TDL_init(TimerHandle_t * handle);
+
+void TDL_deinit();
+
+//prepares a deadline node for use
+void TDL_initDeadline(TimerDeadline_t * deadline, TimerDeadlineCallback_t callback, void * data);
+
+//how many ticks late a deadline may fire so it can share an interrupt with others. Takes effect the next time the deadline is added
+void TDL_setSlack(TimerDeadline_t * deadline, uint32_t slack_ticks);
+
+//queues a deadline at an absolute tick count. Re-queues it if it was already pending. Deadlines in the past fire as soon as possible. Returns pdFAIL if the queue is full or the scheduler isn't initialised
+uint32_t TDL_add(TimerDeadline_t * deadline, uint64_t ticks);
+
+//queues a deadline relative to now
+uint32_t TDL_addIn(TimerDeadline_t * deadline, uint64_t delay_ticks);
+
+//removes a deadline from the queue. Does nothing if it isn't pending
+void TDL_cancel(TimerDeadline_t * deadline);
+
+uint32_t TDL_isPending(TimerDeadline_t * deadline);
+
+//returns the current time in ticks since TDL_init, 0 while the scheduler isn't initialised
+uint64_t TDL_now();
+
+void TDL_getStats(TimerDeadlineStats_t * stats);
+void TDL_resetStats();
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef TimerDefer_INC
+#define TimerDefer_INC
+
+/*
+* Deferred timer callbacks for the Pic32Timer Library
+*
+* Instead of running a callback in the timer interrupt, the interrupt only pushes a small timestamped event into a ring buffer and
+* notifies a worker task, which then runs the callbacks of everything that expired in task context.
+*
+* There is one ring per interrupt priority level. Interrupts of the same level can't preempt each other, so every ring only ever has one producer
+* at a time and needs no locking. The worker drains the rings in batches, highest level first. Several expiries in a row only cause a single
+* context switch since the notification just counts up until the worker runs.
+*
+* Timers using this must have an interrupt priority at or below configMAX_SYSCALL_INTERRUPT_PRIORITY, and the priority must be set before TDEF_attach.
+*/
+
+#include <stdint.h>
+
+#include "Timer.h"
+
+//number of events each ring can hold. Must be a power of two
+#ifndef TDEF_RING_SIZE
+#define TDEF_RING_SIZE 16
+#endif
+
+//worker task parameters
+#ifndef TDEF_TASK_STACK_SIZE
+#define TDEF_TASK_STACK_SIZE 256
+#endif
+
+//free running counter used to timestamp the events
+#ifndef TDEF_TIMESTAMP
+#ifdef TMR_SIMULATION
+#define TDEF_TIMESTAMP() ((uint32_t) TMR_SIM_getCycles())
+#else
+#define TDEF_TIMESTAMP() _CP0_GET_COUNT()
+#endif
+#endif
+
+//prototype of a deferred callback. timestamp is the TDEF_TIMESTAMP() value taken in the interrupt
+typedef void (*TimerDeferredCallback_t)(TimerHandle_t * handle, uint32_t timestamp, void * data);
+
+//binding of a timer to a deferred callback, must stay valid while it is attached and until the worker ran after TDEF_detach
+typedef struct{
+    TimerHandle_t * handle;
+    TimerDeferredCallback_t callback;
+    void * data;
+    
+    //ring the interrupt of the timer pushes into
+    uint32_t level;
+    
+    //events that were lost because the ring was full
+    volatile uint32_t dropped;
+} TimerDeferred_t;
+
+//creates the worker task. Not available in the simulation, call TDEF_process from the test code there instead
+uint32_t TDEF_init(uint32_t taskPriority);
+
+//routes the interrupts of a timer to the worker. Fails if the timer already has a callback, remove that with TMR_setISR(handle, NULL, NULL) first.
+//Events that come in before TDEF_init wait in the rings until the worker runs
+uint32_t TDEF_attach(TimerDeferred_t * deferred, TimerHandle_t * handle, TimerDeferredCallback_t callback, void * data);
+void TDEF_detach(TimerDeferred_t * deferred);
+
+//runs the callbacks of all queued events and returns how many there were. This is what the worker task does every time it wakes up
+uint32_t TDEF_process();
+
+#endif
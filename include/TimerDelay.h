@@ -0,0 +1,59 @@
+#ifndef TimerDelay_INC
+#define TimerDelay_INC
+
+/*
+* Calibrated delays for the Pic32Timer Library
+*
+* Busy waits on a free running timer, so the delay doesn't depend on compiler settings or cpu clock. The time a delay call takes on top of
+* the wait itself is measured once at TDLY_init and subtracted from every delay.
+*
+* Delays longer than TDLY_YIELD_THRESHOLD_US block the calling task with vTaskDelay for the whole ticks that fit into them and only busy wait the rest,
+* so the cpu is free for other tasks in the meantime. Before the scheduler runs, and in the simulation, every delay is a busy wait.
+*
+* All waits add up differences of counter values, so they work across the counter wrapping and any delay that fits in 32bit of counter ticks works,
+* on 16bit timers too. The counter must not wrap twice between two looks at it though: the busy wait looks all the time, and the rtos sleeps are cut into pieces
+* of at most half a counter period. A 16bit timer with a period shorter than two rtos ticks only busy waits. TDLY_delayUntil can reach at most half a counter period ahead.
+*/
+
+#include <stdint.h>
+
+#include "Timer.h"
+
+//delays at least this long yield to the rtos
+#ifndef TDLY_YIELD_THRESHOLD_US
+#define TDLY_YIELD_THRESHOLD_US 2000
+#endif
+
+//body of the busy wait loop
+#ifndef TDLY_SPIN
+#ifdef TMR_SIMULATION
+//nothing advances the simulated clock otherwise
+#define TDLY_SPIN() TMR_SIM_advance(1)
+#else
+#define TDLY_SPIN()
+#endif
+#endif
+
+//attaches the delay service to a timer, which is then kept running over its full range. The prescaler sets the resolution and must already be set
+uint32_t TDLY_init(TimerHandle_t * handle);
+
+void TDLY_deinit();
+
+//without a timer attached (before TDLY_init or after TDLY_deinit) the delays return straight away and TDLY_now returns 0
+void TDLY_delay_ns(uint32_t ns);
+void TDLY_delay_us(uint32_t us);
+
+//current counter value, the time base for TDLY_delayUntil
+uint32_t TDLY_now();
+
+//converts a time into counter ticks, for building deadlines. Follows the count rate through clock changes (see TMR_notifyClockChange)
+uint32_t TDLY_nsToTicks(uint32_t ns);
+uint32_t TDLY_usToTicks(uint32_t us);
+
+//waits until the counter reaches deadline. Returns straight away if it is already in the past (up to half a counter period back)
+void TDLY_delayUntil(uint32_t deadline);
+
+//measured overhead of a delay call in counter ticks
+uint32_t TDLY_getOverhead();
+
+#endif
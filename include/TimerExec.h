@@ -0,0 +1,64 @@
+#ifndef TimerExec_INC
+#define TimerExec_INC
+
+/*
+* Rate group cyclic executive for the Pic32Timer Library
+*
+* Runs any number of fixed rate jobs from the interrupt of a single timer. The timer period is the minor frame, every job runs once every
+* "divider" frames. Jobs are kept sorted by their divider so faster jobs always run first (rate monotonic order).
+*
+* When a job is added it gets the phase (the frame it first runs in) that collides the least with the jobs that are already there,
+* so a 1kHz and a 100Hz job on a 10kHz base don't end up in the same frame and the worst case frame stays short.
+*
+* After every job the timer's interrupt flag is checked. If it is set the next period match already happened while the frame was still running,
+* the frame overran and the job that was running gets blamed for it. The counter value at the end of a frame is the time the frame took,
+* its maximum is the measured worst case tick time.
+*/
+
+#include <stdint.h>
+
+#include "Timer.h"
+
+//maximum number of jobs
+#ifndef TCE_MAX_JOBS
+#define TCE_MAX_JOBS 16
+#endif
+
+typedef void (*TimerJobCallback_t)(void * data);
+
+//job node, must stay valid while it is added
+typedef struct{
+    TimerJobCallback_t callback;
+    void * data;
+    
+    uint32_t divider;
+    uint32_t phase;
+    
+    //frames left until the job runs again
+    uint32_t countdown;
+    
+    uint32_t runs;
+    uint32_t overruns;
+} TimerJob_t;
+
+typedef struct{
+    uint32_t frames;
+    uint32_t overruns;
+    
+    //longest frame in timer counts
+    uint32_t worstFrame;
+} TimerExecStats_t;
+
+//attaches the executive to a timer. The timer period (prescaler and PR) is the minor frame and must already be set, this starts the timer
+uint32_t TCE_init(TimerHandle_t * handle);
+
+void TCE_deinit();
+
+//adds a job running every divider frames. Returns pdFAIL if the table is full or the job is already added
+uint32_t TCE_addJob(TimerJob_t * job, TimerJobCallback_t callback, void * data, uint32_t divider);
+void TCE_removeJob(TimerJob_t * job);
+
+void TCE_getStats(TimerExecStats_t * stats);
+void TCE_resetStats();
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef TimerFast_INC
+#define TimerFast_INC
+
+/*
+* Compile time specialised fast path for the Pic32Timer Library
+*
+* Every macro in here takes the timer number (and for interrupt related ones whether it is running as a 32bit pair) as a literal constant.
+* The register addresses, masks and timer type are then resolved by the compiler from the TMR_FAST_* description in TimerFastMap.h,
+* so each call ends up as direct SFR accesses without any descriptor lookups or runtime branches on the timer type.
+*
+* The timer still has to be allocated with Tmr_init, this only replaces the handle based calls on hot paths like control loop isrs.
+*
+* TMRF_setEnabled and TMRF_setPrescaler write TCON without updating the TCON shadow the driver keeps for the handle. A timer whose TCON is changed
+* with them must not have it changed with the handle based calls as well (TMR_setEnabled, TMR_setPrescaler, TMR_setClockSource, TMR_configure,
+* the period and frequency setters, the period queue and sequences), those only write the bits that differ from the shadow and would skip or
+* undo changes. All other macros don't touch TCON and mix with the handle based calls freely.
+*
+* Usage:
+*   TMRF_clearIFS(2, 1);
+*   TMRF_setPrescaler(2, 3);
+*/
+
+#include <stdint.h>
+
+#include "Timer.h"
+#include "TimerConfig.h"
+#include "TimerFastMap.h"
+
+#define TMRF_CAT(a, b) TMRF_CAT_(a, b)
+#define TMRF_CAT_(a, b) a##b
+
+//timer that owns the interrupt. In 32bit mode that is the slave of the pair
+#define TMRF_IRQ_TIMER_0(n) n
+#define TMRF_IRQ_TIMER_1(n) TMR_FAST_SLAVE_##n
+#define TMRF_IRQ_TIMER(n, is32Bit) TMRF_CAT(TMRF_IRQ_TIMER_, is32Bit)(n)
+
+#define TMRF_REGS(n) TMR_FAST_REGS_##n
+#define TMRF_TYPE(n) TMR_FAST_TYPE_##n
+#define TMRF_IEC(n, is32Bit) TMRF_CAT(TMR_FAST_IEC_, TMRF_IRQ_TIMER(n, is32Bit))
+#define TMRF_IFS(n, is32Bit) TMRF_CAT(TMR_FAST_IFS_, TMRF_IRQ_TIMER(n, is32Bit))
+#define TMRF_INTMASK(n, is32Bit) TMRF_CAT(TMR_FAST_INTMASK_, TMRF_IRQ_TIMER(n, is32Bit))
+
+#define TMRF_TCKPS_MASK(n) ((TMRF_TYPE(n) == TmrType_A) ? TMR_TYPEA_TCKPS_MASK : TMR_TYPEB_TCKPS_MASK)
+
+//divider shifts of all TCKPS values packed into nibbles, same as the prescaler tables in Timer.c
+#define TMRF_SHIFT_TABLE(n) ((TMRF_TYPE(n) == TmrType_A) ? 0x8630 : 0x86543210)
+
+//switch the timer on or off. Bypasses the TCON shadow, see above
+#define TMRF_setEnabled(n, on) ((on) ? (TMRF_REGS(n).TCONSET.w = _T1CON_TON_MASK) : (TMRF_REGS(n).TCONCLR.w = _T1CON_TON_MASK))
+#define TMRF_isEnabled(n) (TMRF_REGS(n).TCON.ON)
+
+//set the prescaler (TCKPS value). Uses a CLR and a SET write instead of a read-modify-write. Bypasses the TCON shadow, see above
+#define TMRF_setPrescaler(n, scaler) \
+    do{ \
+        TMRF_REGS(n).TCONCLR.w = TMRF_TCKPS_MASK(n) & ~((uint32_t) (scaler) << TMR_TCKPS_POSITION); \
+        TMRF_REGS(n).TCONSET.w = TMRF_TCKPS_MASK(n) & ((uint32_t) (scaler) << TMR_TCKPS_POSITION); \
+    }while(0)
+
+#define TMRF_getPrescalerShift(n) ((TMRF_SHIFT_TABLE(n) >> (((TMRF_REGS(n).TCON.w & TMRF_TCKPS_MASK(n)) >> TMR_TCKPS_POSITION) * 4)) & 0xf)
+
+//writes PR without the counter reset TMR_setPR does
+#define TMRF_writePR(n, prValue) (TMRF_REGS(n).PR = (prValue))
+#define TMRF_getCount(n) (TMRF_REGS(n).TMR)
+
+//period length in peripheral clocks
+#define TMRF_getPeriodCycles(n) (((uint64_t) TMRF_REGS(n).PR + 1) << TMRF_getPrescalerShift(n))
+
+//period length in us. With a clock thats a whole number of MHz this only needs 32bit divisions by a constant, which the compiler turns into multiplications.
+//The + 1 goes onto the remainder, PR + 1 itself would wrap to 0 for a 32bit pair running over the full range
+#define TMRF_CLK_MHz (TMR_CLK_Hz / 1000000)
+#define TMRF_getPeriod_us(n) \
+    (((TMR_CLK_Hz % 1000000) == 0) \
+        ? (uint32_t) (((uint64_t) (TMRF_REGS(n).PR / TMRF_CLK_MHz) << TMRF_getPrescalerShift(n)) + ((((TMRF_REGS(n).PR % TMRF_CLK_MHz) + 1) << TMRF_getPrescalerShift(n)) / TMRF_CLK_MHz)) \
+        : (uint32_t) ((TMRF_getPeriodCycles(n) * 1000000) / TMR_CLK_Hz))
+
+//interrupt control. is32Bit must be 0 or 1 and match the mode the timer was opened in
+#define TMRF_setIRQEnabled(n, is32Bit, on) ((on) ? (TMRF_IEC(n, is32Bit).SET = TMRF_INTMASK(n, is32Bit)) : (TMRF_IEC(n, is32Bit).CLR = TMRF_INTMASK(n, is32Bit)))
+#define TMRF_isIRQEnabled(n, is32Bit) ((TMRF_IEC(n, is32Bit).w & TMRF_INTMASK(n, is32Bit)) != 0)
+#define TMRF_readIFS(n, is32Bit) ((TMRF_IFS(n, is32Bit).w & TMRF_INTMASK(n, is32Bit)) != 0)
+#define TMRF_clearIFS(n, is32Bit) (TMRF_IFS(n, is32Bit).CLR = TMRF_INTMASK(n, is32Bit))
+
+#endif
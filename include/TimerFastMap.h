@@ -0,0 +1,77 @@
+#ifndef TimerFastMap_INC
+#define TimerFastMap_INC
+
+/*
+* Compile time description of the timers for the fast path API, only included by TimerFast.h
+*
+* Timer numbers start at 1 just like for Tmr_init. The layout below is the one of the pic32mx1xx/2xx map in TimerConfig.c and of the simulated device in TimerSim.c,
+* the register names come from xc.h. A device with a different layout defines all of the TMR_FAST_* macros in its TimerConfig.h, this file is skipped then.
+*/
+
+#ifndef TMR_FAST_TYPE_1
+#define TMR_FAST_TYPE_1 TmrType_A
+#define TMR_FAST_TYPE_2 TmrType_B_Master
+#define TMR_FAST_TYPE_3 TmrType_B_Slave
+#define TMR_FAST_TYPE_4 TmrType_B_Master
+#define TMR_FAST_TYPE_5 TmrType_B_Slave
+
+//slave timer of every master timer, its interrupt is used in 32bit mode
+#define TMR_FAST_SLAVE_2 3
+#define TMR_FAST_SLAVE_4 5
+
+#ifdef TMR_SIMULATION
+extern TmrMap_t Tmr_SimTimers[];
+extern Pic32SetClearMap_t Tmr_SimIEC0;
+extern Pic32SetClearMap_t Tmr_SimIFS0;
+
+#define TMR_FAST_REGS_1 (*(volatile TmrMap_t *) &Tmr_SimTimers[0])
+#define TMR_FAST_REGS_2 (*(volatile TmrMap_t *) &Tmr_SimTimers[1])
+#define TMR_FAST_REGS_3 (*(volatile TmrMap_t *) &Tmr_SimTimers[2])
+#define TMR_FAST_REGS_4 (*(volatile TmrMap_t *) &Tmr_SimTimers[3])
+#define TMR_FAST_REGS_5 (*(volatile TmrMap_t *) &Tmr_SimTimers[4])
+
+#define TMR_FAST_IEC_1 (*(volatile Pic32SetClearMap_t *) &Tmr_SimIEC0)
+#define TMR_FAST_IEC_2 TMR_FAST_IEC_1
+#define TMR_FAST_IEC_3 TMR_FAST_IEC_1
+#define TMR_FAST_IEC_4 TMR_FAST_IEC_1
+#define TMR_FAST_IEC_5 TMR_FAST_IEC_1
+
+#define TMR_FAST_IFS_1 (*(volatile Pic32SetClearMap_t *) &Tmr_SimIFS0)
+#define TMR_FAST_IFS_2 TMR_FAST_IFS_1
+#define TMR_FAST_IFS_3 TMR_FAST_IFS_1
+#define TMR_FAST_IFS_4 TMR_FAST_IFS_1
+#define TMR_FAST_IFS_5 TMR_FAST_IFS_1
+
+#define TMR_FAST_INTMASK_1 (1 << 4)
+#define TMR_FAST_INTMASK_2 (1 << 9)
+#define TMR_FAST_INTMASK_3 (1 << 14)
+#define TMR_FAST_INTMASK_4 (1 << 19)
+#define TMR_FAST_INTMASK_5 (1 << 24)
+#else
+#define TMR_FAST_REGS_1 (*(volatile TmrMap_t *) &T1CON)
+#define TMR_FAST_REGS_2 (*(volatile TmrMap_t *) &T2CON)
+#define TMR_FAST_REGS_3 (*(volatile TmrMap_t *) &T3CON)
+#define TMR_FAST_REGS_4 (*(volatile TmrMap_t *) &T4CON)
+#define TMR_FAST_REGS_5 (*(volatile TmrMap_t *) &T5CON)
+
+#define TMR_FAST_IEC_1 (*(volatile Pic32SetClearMap_t *) &IEC0)
+#define TMR_FAST_IEC_2 TMR_FAST_IEC_1
+#define TMR_FAST_IEC_3 TMR_FAST_IEC_1
+#define TMR_FAST_IEC_4 TMR_FAST_IEC_1
+#define TMR_FAST_IEC_5 TMR_FAST_IEC_1
+
+#define TMR_FAST_IFS_1 (*(volatile Pic32SetClearMap_t *) &IFS0)
+#define TMR_FAST_IFS_2 TMR_FAST_IFS_1
+#define TMR_FAST_IFS_3 TMR_FAST_IFS_1
+#define TMR_FAST_IFS_4 TMR_FAST_IFS_1
+#define TMR_FAST_IFS_5 TMR_FAST_IFS_1
+
+#define TMR_FAST_INTMASK_1 _IFS0_T1IF_MASK
+#define TMR_FAST_INTMASK_2 _IFS0_T2IF_MASK
+#define TMR_FAST_INTMASK_3 _IFS0_T3IF_MASK
+#define TMR_FAST_INTMASK_4 _IFS0_T4IF_MASK
+#define TMR_FAST_INTMASK_5 _IFS0_T5IF_MASK
+#endif
+#endif
+
+#endif
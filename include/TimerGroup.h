@@ -0,0 +1,50 @@
+#ifndef TimerGroup_INC
+#define TimerGroup_INC
+
+/*
+* Phase synchronised timer groups for the Pic32Timer Library
+*
+* Every timer has its own TCON so there is no single write that starts several of them. Instead the group starts its members with back to back
+* TCONSET writes from a precomputed list inside a critical section, which makes the delay between two starts constant (TMR_GROUP_WRITE_SKEW_CYCLES).
+* Each member's counter is preloaded with its phase offset plus the skew it is going to see, so all members are aligned once the last one runs.
+*
+* Stopping goes through the members in the same order as starting, so every member gets stopped exactly as much later as it was started.
+* A TGRP_resume after TGRP_stop therefore keeps the relative phase without touching the counters.
+*/
+
+#include <stdint.h>
+
+#include "Timer.h"
+
+//maximum number of timers in one group
+#ifndef TGRP_MAX_MEMBERS
+#define TGRP_MAX_MEMBERS TMR_NUM_TIMERS
+#endif
+
+typedef struct{
+    TimerHandle_t * members[TGRP_MAX_MEMBERS];
+    
+    //counter value each member starts at relative to the first one, in counts of that member
+    uint32_t phase[TGRP_MAX_MEMBERS];
+    
+    //ON bit ports of the members, so the start and stop loops don't need any descriptor lookups
+    volatile uint32_t * tconSet[TGRP_MAX_MEMBERS];
+    volatile uint32_t * tconClr[TGRP_MAX_MEMBERS];
+    
+    uint32_t count;
+} TimerGroup_t;
+
+void TGRP_init(TimerGroup_t * group);
+
+//adds a timer to the group. phase is the counter value it should have when the first member is at 0. The timer must not be in another group
+uint32_t TGRP_add(TimerGroup_t * group, TimerHandle_t * handle, uint32_t phase);
+uint32_t TGRP_remove(TimerGroup_t * group, TimerHandle_t * handle);
+
+//stops all members, loads their counters with the phase offsets and starts them together
+void TGRP_start(TimerGroup_t * group);
+
+//stops and restarts all members without changing their relative phase
+void TGRP_stop(TimerGroup_t * group);
+void TGRP_resume(TimerGroup_t * group);
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef TimerMeasure_INC
+#define TimerMeasure_INC
+
+/*
+* Frequency and pulse width measurement for the Pic32Timer Library
+*
+* Uses two timers: a counter timer that is clocked or gated by the input signal, and a window timer whose interrupt collects the counter value at
+* a fixed rate. The last TMS_AVERAGE_LENGTH windows are kept and all results are averages over them, so the caller never has to look at a register.
+*
+* Frequency mode: the counter counts the rising edges on its external clock pin (TxCK). Its overflows are counted in its interrupt,
+* so even signals with more than 65535 edges per window don't wrap.
+*
+* Pulse width mode: the counter runs from the peripheral clock while its gate pin is high, accumulating the high time over the window.
+* Its interrupt fires on every falling edge of the gate and counts the pulses. The prescaler is picked so a full window never overflows the counter.
+* Average pulse width, frequency and duty cycle are all derived from those two numbers.
+*/
+
+#include <stdint.h>
+
+#include "Timer.h"
+
+//number of windows the results are averaged over. Must be a power of two
+#ifndef TMS_AVERAGE_LENGTH
+#define TMS_AVERAGE_LENGTH 8
+#endif
+
+typedef enum {TmsMode_Frequency, TmsMode_PulseWidth} TimerMeasureMode_t;
+
+typedef struct TimerMeasure_s TimerMeasure_t;
+
+//called from the window isr after every decimation windows
+typedef void (*TimerMeasureCallback_t)(TimerMeasure_t * measure, void * data);
+
+//measurement state, must stay valid while the measurement is running
+struct TimerMeasure_s{
+    TimerHandle_t * counter;
+    TimerHandle_t * window;
+    TimerMeasureMode_t mode;
+    
+    //length of one window in peripheral clocks and the divider shift of the counter
+    uint32_t windowCycles;
+    uint32_t counterShift;
+    
+    //updated by the counter isr
+    volatile uint32_t overflows;
+    volatile uint32_t edges;
+    
+    //values at the end of the last window
+    uint64_t lastTotal;
+    uint32_t lastEdges;
+    
+    //per window results, counter ticks and pulses
+    uint32_t counts[TMS_AVERAGE_LENGTH];
+    uint32_t pulses[TMS_AVERAGE_LENGTH];
+    uint32_t index;
+    uint32_t filled;
+    
+    TimerMeasureCallback_t callback;
+    void * data;
+    uint32_t decimation;
+    uint32_t decimationCount;
+};
+
+//starts a measurement. counter gets its clock source and prescaler set up here, window_us is the length of a single averaging window
+//fails if either timer already has an isr bound, both timers are stopped and the counter is back on the peripheral clock then
+uint32_t TMS_init(TimerMeasure_t * measure, TimerMeasureMode_t mode, TimerHandle_t * counter, TimerHandle_t * window, uint32_t window_us);
+
+void TMS_deinit(TimerMeasure_t * measure);
+
+//calls callback every decimation windows, for example to log a new average. Pass NULL to stop
+void TMS_setCallback(TimerMeasure_t * measure, TimerMeasureCallback_t callback, void * data, uint32_t decimation);
+
+//averaged results. Return 0 until the first window is complete. The frequency saturates at 0xffffffff (about 4.29MHz)
+uint32_t TMS_getFrequency_mHz(TimerMeasure_t * measure);
+
+//pulse width mode only
+uint32_t TMS_getPulseWidth_ns(TimerMeasure_t * measure);
+uint32_t TMS_getDutyCycle_ppm(TimerMeasure_t * measure);
+
+//drops all averages collected so far
+void TMS_reset(TimerMeasure_t * measure);
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef Timer_SIM
+#define Timer_SIM
+
+/*
+* Host simulation backend for the Pic32Timer Library
+*
+* Define TMR_SIMULATION project wide and build TimerSim.c instead of TimerConfig.c to run the driver on a normal pc.
+* The timers then live in a fake register file that is clocked by a virtual peripheral clock. Advancing that clock counts up TMR
+* (with the prescaler applied), matches it against PR, sets the IFS bits and calls TMR_isrHandler just like the generated ISRs in TimerConfig.c would.
+*
+* SET/CLR/INV writes can't be intercepted on a normal cpu, so they are folded into the base register every time the simulator runs (CLR first, then SET, then INV).
+* Every write the driver makes goes through TMR_REG_WRITE, which folds it right away (see TimerTrace.h). Writes from outside the driver, like the
+* TimerFast.h macros, are only folded when the simulator runs: reading back the register in between sees the old value and two writes to the same
+* port only keep the last one. Call TMR_SIM_sync() in between if that matters.
+*/
+
+#include <stdint.h>
+#include <stdlib.h>
+
+//host stand-ins for the things the driver otherwise gets from xc.h, System.h, util.h and FreeRTOS.h
+typedef struct{
+    uint32_t w;
+    uint32_t CLR;
+    uint32_t SET;
+    uint32_t INV;
+} Pic32SetClearMap_t;
+
+typedef union{
+    struct{
+        uint32_t subPriority:2;
+        uint32_t priority:3;
+    };
+    uint32_t map;
+} Pic32PrioBits_t;
+
+#ifndef arraySize
+#define arraySize(X) (sizeof(X) / sizeof(X[0]))
+#endif
+
+#ifndef pdPASS
+#define pdPASS 1
+#define pdFAIL 0
+#endif
+
+//what TimerConfig.h builds TMR_MALLOC, TMR_CLK_Hz and the critical sections from. Nothing can interrupt the simulator
+#define pvPortMalloc(X) malloc(X)
+#define vPortFree(X) free(X)
+#define configPERIPHERAL_CLOCK_HZ TMR_SIM_CLK_Hz
+#define taskENTER_CRITICAL()
+#define taskEXIT_CRITICAL()
+
+//the simulator applies all writes at the same time
+#define TMR_GROUP_WRITE_SKEW_CYCLES 0
+
+//the kernel side of TimerTickless.c. The rtos tick comes from timer 1, the simulator plays the kernel (see TMR_SIM_setSleepStatus)
+#ifndef configTICK_RATE_HZ
+#define configTICK_RATE_HZ 1000
+#endif
+#define configTICK_INTERRUPT_VECTOR 4
+
+typedef enum {eAbortSleep, eStandardSleep} eSleepModeStatus;
+
+eSleepModeStatus eTaskConfirmSleepModeStatus();
+void vTaskStepTick(uint32_t ticks);
+
+//interrupts only ever run from the simulator anyway
+#define __builtin_disable_interrupts()
+#define __builtin_enable_interrupts()
+
+#define _T1CON_TON_MASK 0x00008000
+
+//clock the simulated timers are running from, can be overridden from the command line
+#ifndef TMR_SIM_CLK_Hz
+#define TMR_SIM_CLK_Hz 40000000
+#endif
+
+//number of timers in the simulated device. Same layout as the pic32mx1xx/2xx map in TimerConfig.c
+#define TMR_SIM_NUM_TIMERS 5
+
+//resets all simulated registers to their power on values and sets the virtual clock back to 0
+void TMR_SIM_reset();
+
+//applies all pending SET/CLR/INV writes to the simulated registers
+void TMR_SIM_sync();
+
+//same for the register group of a single register only, used after every write of the driver
+void TMR_SIM_syncRegister(volatile uint32_t * reg);
+
+//runs the virtual peripheral clock for the given number of cycles, calling TMR_isrHandler for every interrupt that occurs on the way
+void TMR_SIM_advance(uint64_t cycles);
+
+//runs any interrupt that is currently flagged and enabled without advancing the clock (for example after software set an IFS bit)
+void TMR_SIM_dispatchPending();
+
+//returns the number of peripheral clock cycles simulated since the last reset
+uint64_t TMR_SIM_getCycles();
+
+//runs the clock until an enabled interrupt is flagged but doesn't call it, like the wait instruction with interrupts disabled.
+//Returns straight away if one is flagged already or no timer that could flag one is counting
+void TMR_SIM_wait();
+
+//what eTaskConfirmSleepModeStatus returns from now on, eStandardSleep after a reset
+void TMR_SIM_setSleepStatus(eSleepModeStatus status);
+
+//ticks passed to vTaskStepTick since the last reset
+uint32_t TMR_SIM_getSteppedTicks();
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef TimerTickless_INC
+#define TimerTickless_INC
+
+/*
+* FreeRTOS tickless idle for the Pic32Timer Library
+*
+* Lets the idle task sleep through any number of ticks instead of waking up for every single one. A 32bit timer pair from this library is used as the
+* wake up timer, programmed in single shot fashion to fire right before the tick the next task is due in.
+*
+* The RTOS tick timer itself keeps counting while its interrupt is masked, so its phase never drifts. On wake up the number of ticks that passed
+* is worked out from the pair's count plus the tick timer phase at the start, and the missed ticks are handed to vTaskStepTick.
+*
+* The cpu waits in idle mode, the peripheral bus clock keeps running for both timers. Set up in FreeRTOSConfig.h:
+*   #define configUSE_TICKLESS_IDLE 1
+*   #define portSUPPRESS_TICKS_AND_SLEEP(idleTicks) TTL_suppressTicksAndSleep(idleTicks)
+*/
+
+#include <stdint.h>
+
+#include "Timer.h"
+
+//peripheral clocks between reading the tick timer phase and starting the wake up timer, added to the time measured by the wake up timer
+#ifndef TTL_OVERHEAD_CYCLES
+#define TTL_OVERHEAD_CYCLES 24
+#endif
+
+//don't bother sleeping for less than this many ticks
+#ifndef TTL_MIN_IDLE_TICKS
+#define TTL_MIN_IDLE_TICKS 2
+#endif
+
+//optional hooks around the wait instruction, for example to switch off peripherals
+#ifndef TTL_PRE_SLEEP
+#define TTL_PRE_SLEEP()
+#endif
+
+#ifndef TTL_POST_SLEEP
+#define TTL_POST_SLEEP()
+#endif
+
+//waits for the wake up timer, or whatever else interrupts first
+#ifndef TTL_WAIT
+#ifdef TMR_SIMULATION
+#define TTL_WAIT() TMR_SIM_wait()
+#else
+#define TTL_WAIT() __asm__ volatile("wait")
+#endif
+#endif
+
+//attaches the wake up timer to a 32bit timer pair. Fails if the RTOS tick doesn't come from one of the timers in Tmr_TimerMap
+uint32_t TTL_init(TimerHandle_t * handle);
+
+void TTL_deinit();
+
+//portSUPPRESS_TICKS_AND_SLEEP implementation, called by the idle task with interrupts enabled
+void TTL_suppressTicksAndSleep(uint32_t expectedIdleTicks);
+
+//number of ticks skipped by sleeping since TTL_init
+uint32_t TTL_getSleptTicks();
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef TimerTimestamp_INC
+#define TimerTimestamp_INC
+
+/*
+* 64bit monotonic timestamps for the Pic32Timer Library
+*
+* Runs a 32bit timer pair (opened with Tmr_init(n, 1)) free running over its full range and counts its overflows in the timer interrupt.
+* Reads combine both without a critical section: the overflow count is read before and after the counter and a still pending overflow
+* interrupt is accounted for, so a read never returns a torn or backwards value.
+*
+* Reads from interrupts are only safe if the timestamp timer has an interrupt priority at least as high as the reader, otherwise the reader
+* could run in the few instructions between the overflow flag being cleared and the count being updated.
+*/
+
+#include <stdint.h>
+
+#include "Timer.h"
+
+//attaches the timestamp service to a 32bit timer pair. The prescaler must already be set, the counter gets reset
+uint32_t TTS_init(TimerHandle_t * handle);
+
+void TTS_deinit();
+
+//returns the current time in counter ticks since TTS_init
+uint64_t TTS_getTicks();
+
+//rate the timestamp counts at. Follows clock changes (see TMR_notifyClockChange), which only alter it if the clock didn't change by a power of two
+uint32_t TTS_getTickFrequency_Hz();
+
+//conversions from ticks, done with a precomputed fixed point factor instead of a division. Always at the current rate
+uint64_t TTS_ticksToNs(uint64_t ticks);
+uint64_t TTS_ticksToUs(uint64_t ticks);
+
+//current time since TTS_init, continuous across clock changes
+uint64_t TTS_getNs();
+uint64_t TTS_getUs();
+
+#endif
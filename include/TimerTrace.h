@@ -0,0 +1,99 @@
+#ifndef TimerTrace_INC
+#define TimerTrace_INC
+
+/*
+* Register access trace for the Pic32Timer Library
+*
+* Every access the driver makes to the timer registers (TCON, TMR, PR and their SET/CLR/INV ports) and to the IEC, IFS and IPC registers goes through
+* TMR_REG_READ and TMR_REG_WRITE. With TMR_ENABLE_REG_TRACE set to 0 in TimerConfig.h those are plain loads and stores and nothing of this module is compiled in.
+*
+* With the trace on every access is counted and, while logging is switched on, recorded into a ring buffer of TMR_TRACE_BUFFER_SIZE entries.
+* Wrap the calls you want to look at in TMR_traceBegin and TMR_traceEnd (or use TMR_TRACE_CALL) to get the counts of just that call,
+* the records of it are tagged with the label passed to TMR_traceBegin. Accesses made by interrupts in between are counted as part of the call.
+*
+* A write is counted as redundant if it doesn't change anything: a plain write of the value the register already holds, a SET of bits that are all set already,
+* a CLR of bits that are all clear or an INV of 0. Those are the first candidates when cutting down register traffic.
+*
+* Accesses through the pointers from TMR_getTMRPointer/TMR_getPRPointer, the fast path API in TimerFast.h and the isr statistics samples aren't traced.
+*
+* In the simulator the pending SET/CLR/INV writes are folded right after every traced write, so register values read back by the driver are exact.
+*/
+
+#include <stdint.h>
+
+#include "TimerConfig.h"
+
+//number of records kept in the ring buffer, must be a power of two
+#ifndef TMR_TRACE_BUFFER_SIZE
+#define TMR_TRACE_BUFFER_SIZE 64
+#endif
+
+//record types
+#define TMR_TRACE_READ 0x00000001
+#define TMR_TRACE_WRITE 0x00000002
+#define TMR_TRACE_REDUNDANT 0x00000004
+
+typedef struct{
+    const char * label;
+    const volatile uint32_t * address;
+    uint32_t value;
+    uint32_t type;
+} TimerTraceRecord_t;
+
+typedef struct{
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t redundantWrites;
+} TimerTraceCounts_t;
+
+//printf compatible output function for TMR_traceDump
+typedef int (*TimerTracePrint_t)(const char * format, ...);
+
+#if TMR_ENABLE_REG_TRACE
+
+#define TMR_REG_READ(reg) Tmr_traceRead(&(reg))
+#define TMR_REG_WRITE(reg, value) Tmr_traceWrite(&(reg), (value))
+
+//runs a single call with its own counts
+#define TMR_TRACE_CALL(label, counts, call) do{ TMR_traceBegin(label); call; TMR_traceEnd(counts); }while(0)
+
+uint32_t Tmr_traceRead(const volatile uint32_t * reg);
+void Tmr_traceWrite(volatile uint32_t * reg, uint32_t value);
+
+//starts counting a new call. The counts since the last begin are dropped
+void TMR_traceBegin(const char * label);
+
+//ends the call and returns its counts
+void TMR_traceEnd(TimerTraceCounts_t * counts);
+
+//counts of everything since the last TMR_traceReset
+void TMR_traceGetTotals(TimerTraceCounts_t * counts);
+
+//switches recording into the ring buffer on or off. Counting always runs
+void TMR_traceSetLogging(uint32_t on);
+
+//clears the counts and the ring buffer
+void TMR_traceReset();
+
+//prints the records in the ring buffer, oldest first, one line each
+void TMR_traceDump(TimerTracePrint_t print);
+
+//copies out up to maxCount of the newest records, oldest first. Returns the number of records copied
+uint32_t TMR_traceGetRecords(TimerTraceRecord_t * records, uint32_t maxCount);
+
+#else
+
+#define TMR_REG_READ(reg) (reg)
+
+#ifdef TMR_SIMULATION
+//the simulator folds every write of the driver right away, like the hardware would (see TimerSim.h)
+#define TMR_REG_WRITE(reg, value) do{ (reg) = (value); TMR_SIM_syncRegister((volatile uint32_t *) &(reg)); }while(0)
+#else
+#define TMR_REG_WRITE(reg, value) ((reg) = (value))
+#endif
+
+#define TMR_TRACE_CALL(label, counts, call) do{ call; }while(0)
+
+#endif
+
+#endif
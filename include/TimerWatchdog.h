@@ -0,0 +1,80 @@
+#ifndef TimerWatchdog_INC
+#define TimerWatchdog_INC
+
+/*
+* Deadline miss watchdog for the Pic32Timer Library
+*
+* Jobs (tasks, control loops, anything periodic) check in with TWD_start when they begin and TWD_complete when they are done. Both only take a timestamp
+* from the timer and flip a bit in the armed mask. The timer interrupt fires every period, walks the armed jobs and calls the miss handler once
+* for every job that is past its deadline and still not complete.
+*
+* How late a miss is detected depends on the timer period, which the caller sets before TWD_init. Completion also catches misses the scan didn't see yet,
+* so the miss counts are exact, only the handler may come up to one period late.
+*
+* All times are in counts of the timer. The time base wraps after 2^32 counts, so no job may take longer than 2^31 counts.
+* PR is claimed at TWD_init (see TMR_claimPR). If a clock change leaves the timer with a new count rate, the budgets of the registered jobs are scaled to it.
+*/
+
+#include <stdint.h>
+
+#include "Timer.h"
+
+//maximum number of registered jobs, at most 32
+#ifndef TWD_MAX_JOBS
+#define TWD_MAX_JOBS 32
+#endif
+
+#define TWD_NOT_REGISTERED 0xffffffff
+
+//initialiser for a job that isn't registered yet
+#define TWD_JOB_INITIALIZER {.slot = TWD_NOT_REGISTERED}
+
+typedef struct TimerWatchJob_s TimerWatchJob_t;
+
+//called from the timer interrupt when a job missed its deadline
+typedef void (*TimerMissHandler_t)(TimerWatchJob_t * job, void * data);
+
+//job node, must stay valid while it is registered
+struct TimerWatchJob_s{
+    //time the job may take from TWD_start to TWD_complete
+    uint32_t budget;
+    
+    uint32_t start;
+    uint32_t deadline;
+    volatile uint32_t missed;
+    
+    uint32_t slot;
+    
+    //statistics, execution times are in timer counts
+    uint32_t runs;
+    uint32_t misses;
+    uint32_t wcet;
+    uint32_t lastExecutionTime;
+};
+
+//attaches the watchdog to a timer. Its period must already be set and is the scan interval
+uint32_t TWD_init(TimerHandle_t * handle, TimerMissHandler_t missHandler, void * data);
+
+void TWD_deinit();
+
+//adds a job with the time it may take per run, in timer counts. Fails if the job is registered already or all slots are taken
+uint32_t TWD_register(TimerWatchJob_t * job, uint32_t budget);
+void TWD_unregister(TimerWatchJob_t * job);
+
+//the job started and must complete within its budget. Start, startBy and complete ignore jobs that aren't registered, and everything before TWD_init
+void TWD_start(TimerWatchJob_t * job);
+
+//the job started and must complete by an absolute time
+void TWD_startBy(TimerWatchJob_t * job, uint32_t deadline);
+
+//the job is done. Returns 1 if it made its deadline, 0 if it missed it, isn't registered or there is no TWD_init yet
+uint32_t TWD_complete(TimerWatchJob_t * job);
+
+//current time in timer counts, the base for TWD_startBy. 0 before TWD_init
+uint32_t TWD_now();
+
+uint32_t TWD_usToCounts(uint32_t us);
+
+void TWD_resetStats(TimerWatchJob_t * job);
+
+#endif
@@ -0,0 +1,82 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "Timer.h"
+#include "TimerConfig.h"
+#include "TimerTrace.h"
+
+/*
+* Benchmarks for the hot paths of the Pic32Timer Library, run against the register simulator in TimerSim.c (see the Makefile in this directory).
+*
+* The times are host times and include the simulator folding every register write, so only compare them between builds on the same machine.
+* Build with TMR_ENABLE_REG_TRACE set to also get the register accesses per call, those carry over to the target directly.
+*/
+
+#define BENCH_ITERATIONS 1000000
+
+static volatile uint32_t benchSink;
+
+static uint64_t benchNow_ns(){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+static void benchReport(const char * name, uint64_t elapsed_ns, TimerHandle_t * handle, void (*call)(TimerHandle_t *, uint32_t)){
+    printf("%-28s %8.1f ns/call", name, (double) elapsed_ns / BENCH_ITERATIONS);
+
+#if TMR_ENABLE_REG_TRACE
+    //one more call on its own for the register accesses
+    TimerTraceCounts_t counts;
+    TMR_TRACE_CALL(name, &counts, call(handle, BENCH_ITERATIONS));
+    printf("  %u reads %u writes (%u redundant)", counts.reads, counts.writes, counts.redundantWrites);
+#endif
+
+    printf("\n");
+}
+
+static void benchSetPeriod(TimerHandle_t * handle, uint32_t i){
+    //alternate between a few periods that need different prescalers
+    benchSink = TMR_setPeriod(handle, 100 + (i & 7) * 10000);
+}
+
+static void benchCalculatePR(TimerHandle_t * handle, uint32_t i){
+    benchSink = TMR_calculatePR(handle, 100 + (i & 1023), i & 7);
+}
+
+static void benchSetFrequency(TimerHandle_t * handle, uint32_t i){
+    //the rates repeat, so after the first round these are rate cache hits
+    benchSink = TMR_setFrequency(handle, 1000000 + (i & 3) * 1000);
+}
+
+static uint32_t benchIsr(TimerHandle_t * handle, uint32_t flags, void * data){
+    benchSink++;
+    return 0;
+}
+
+static void benchDispatch(TimerHandle_t * handle, uint32_t i){
+    //what the generated isr of timer 2 does after clearing the flag
+    TMR_isrHandler(1);
+}
+
+static void benchRun(const char * name, TimerHandle_t * handle, void (*call)(TimerHandle_t *, uint32_t)){
+    uint64_t start = benchNow_ns();
+    for(uint32_t i = 0; i < BENCH_ITERATIONS; i++) call(handle, i);
+    benchReport(name, benchNow_ns() - start, handle, call);
+}
+
+int main(){
+    TMR_SIM_reset();
+
+    TimerHandle_t * handle = Tmr_init(2, 0);
+    TMR_setISR(handle, benchIsr, NULL);
+
+    benchRun("TMR_setPeriod", handle, benchSetPeriod);
+    benchRun("TMR_calculatePR", handle, benchCalculatePR);
+    benchRun("TMR_setFrequency (cached)", handle, benchSetFrequency);
+    benchRun("isr dispatch", handle, benchDispatch);
+
+    TMR_deinit(handle);
+    return 0;
+}
@@ -0,0 +1,1279 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "Timer.h"
+#include "TimerConfig.h"
+#include "SoftTimer.h"
+#include "TimerDeadline.h"
+#include "TimerWatchdog.h"
+#include "TimerDefer.h"
+#include "TimerGroup.h"
+#include "TimerMeasure.h"
+#include "TimerDelay.h"
+#include "TimerTrace.h"
+#include "TimerTimestamp.h"
+#include "TimerTickless.h"
+#include "TimerExec.h"
+#include "TimerConst.h"
+#include "TimerFast.h"
+
+/*
+* Unit tests for the Pic32Timer Library, run against the register simulator in TimerSim.c (see the Makefile in this directory).
+* Every test starts from a reset simulator and frees the timers it allocated, so they can run in any order.
+*/
+
+static uint32_t checks = 0;
+static uint32_t failures = 0;
+
+#define CHECK(condition) \
+    do{ \
+        checks++; \
+        if(!(condition)){ \
+            failures++; \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        } \
+    }while(0)
+
+#define RUN(test) \
+    do{ \
+        TMR_SIM_reset(); \
+        uint32_t failuresBefore = failures; \
+        test(); \
+        printf("%-28s %s\n", #test, (failures == failuresBefore) ? "ok" : "FAILED"); \
+    }while(0)
+
+//peripheral clocks in a us of the simulated clock
+#define CYCLES_PER_us (TMR_SIM_CLK_Hz / 1000000)
+
+static uint32_t testCountingIsr(TimerHandle_t * handle, uint32_t flags, void * data){
+    (*(uint32_t *) data)++;
+    return 0;
+}
+
+static uint32_t testOtherIsr(TimerHandle_t * handle, uint32_t flags, void * data){
+    return 0;
+}
+
+static void testSetPeriod(){
+    TimerHandle_t * handle = Tmr_init(1, 0);
+    CHECK(handle != TMR_INVALID_HANDLE);
+
+    //1ms is 40000 clocks, that fits a 16bit timer without a prescaler
+    CHECK(TMR_setPeriod(handle, 1000));
+    CHECK(*TMR_getPRPointer(handle) == 1000 * CYCLES_PER_us - 1);
+    CHECK(TMR_getPeriod_us(handle) == 1000);
+
+    uint32_t calls = 0;
+    CHECK(TMR_setISR(handle, testCountingIsr, &calls));
+    TMR_setIRQEnabled(handle, 1);
+    TMR_setEnabled(handle, 1);
+
+    TMR_SIM_advance(10 * 1000 * CYCLES_PER_us);
+    CHECK(calls == 10);
+
+    //1s doesn't fit a 16bit timer even with the largest prescaler, nothing may change then
+    CHECK(!TMR_setPeriod(handle, 1000000));
+    CHECK(TMR_getPeriod_us(handle) == 1000);
+
+    TMR_deinit(handle);
+}
+
+static void testCalculatePR(){
+    TimerHandle_t * handle = Tmr_init(2, 0);
+
+    CHECK(TMR_calculatePR(handle, 1000, 0) == 1000 * CYCLES_PER_us);
+    CHECK(TMR_calculatePR(handle, 1000, 3) == (1000 * CYCLES_PER_us) >> 3);
+    CHECK(TMR_calculatePR(handle, 0xffffffff, 0) == 0);
+    CHECK(TMR_calculatePR(handle, 1000, 8) == 0);
+
+    //type A timers have their own prescaler table, index 1 divides by 8 there
+    TimerHandle_t * typeA = Tmr_init(1, 0);
+    CHECK(TMR_calculatePR(typeA, 1000, 1) == (1000 * CYCLES_PER_us) >> 3);
+    CHECK(TMR_calculatePR(typeA, 1000, 3) == (1000 * CYCLES_PER_us) >> 8);
+    CHECK(TMR_calculatePR(typeA, 1000, 4) == 0);
+
+    TMR_deinit(typeA);
+    TMR_deinit(handle);
+}
+
+static void testCustomDivider(){
+    TimerHandle_t * handle = Tmr_init(2, 0);
+    CHECK(TMR_setPeriod(handle, 1000));
+    TMR_setEnabled(handle, 1);
+
+    //prescaler 2 of a type B timer divides by 4
+    CHECK(TMR_setCustomDivider(handle, 2, 1000));
+    CHECK(*TMR_getPRPointer(handle) == 999);
+    CHECK(TMR_getCountFrequency_Hz(handle) == TMR_SIM_CLK_Hz >> 2);
+    CHECK(TMR_isEnabled(handle));
+
+    //out of range prescalers and dividers leave everything as it was
+    CHECK(!TMR_setCustomDivider(handle, 8, 1000));
+    CHECK(!TMR_setCustomDivider(handle, 0, 1));
+    CHECK(!TMR_setCustomDivider(handle, 0, 0x10001));
+    CHECK(*TMR_getPRPointer(handle) == 999);
+
+    //the divider replaced the period request, a clock change keeps the count rate instead of going back to 1ms
+    TMR_notifyClockChange(2 * TMR_SIM_CLK_Hz);
+    CHECK(*TMR_getPRPointer(handle) == 999);
+    CHECK(TMR_getCountFrequency_Hz(handle) == TMR_SIM_CLK_Hz >> 2);
+
+    TMR_notifyClockChange(TMR_SIM_CLK_Hz);
+    TMR_deinit(handle);
+}
+
+static void testFrequency(){
+    TimerHandle_t * handle = Tmr_init(2, 0);
+
+    CHECK(TMR_setFrequency(handle, 1000000) == 1000000);
+    CHECK(TMR_getFrequency_mHz(handle) == 1000000);
+
+    //the closest rate to the top of the range lies above what the 32bit result can hold, that must saturate instead of wrapping
+    uint32_t prescaler;
+    uint32_t prValue;
+    int32_t error_ppm;
+    CHECK(TMR_calculateFrequency(handle, 0xffffffff, &prescaler, &prValue, &error_ppm) == 0xffffffff);
+    CHECK(error_ppm > 0);
+
+    //same for reading back a PR of 0, that is 40MHz
+    TMR_setPrescalerAndPR(handle, 0, 0);
+    CHECK(TMR_getFrequency_mHz(handle) == 0xffffffff);
+
+    //odd rates that need the full division, compared against the exact result
+    CHECK(TMR_setFrequency(handle, 7777777) != 0);
+    uint64_t cycles = (uint64_t) (*TMR_getPRPointer(handle) + 1) * (TMR_SIM_CLK_Hz / TMR_getCountFrequency_Hz(handle));
+    CHECK(TMR_getFrequency_mHz(handle) == ((uint64_t) TMR_SIM_CLK_Hz * 1000 + cycles / 2) / cycles);
+    CHECK(TMR_getPeriod_us(handle) == cycles * 1000000 / TMR_SIM_CLK_Hz);
+
+    TMR_deinit(handle);
+}
+
+static void testPair(){
+    TimerHandle_t * handle = Tmr_init(2, 1);
+    CHECK(handle != TMR_INVALID_HANDLE);
+
+    //the slave belongs to the pair now
+    CHECK(Tmr_init(3, 0) == TMR_INVALID_HANDLE);
+
+    //1s needs the full 32bit range
+    CHECK(TMR_setPeriod(handle, 1000000));
+    CHECK(*TMR_getPRPointer(handle) == TMR_SIM_CLK_Hz - 1);
+
+    //interrupts come from the slave
+    uint32_t calls = 0;
+    TMR_setISR(handle, testCountingIsr, &calls);
+    TMR_setIRQEnabled(handle, 1);
+    TMR_setEnabled(handle, 1);
+
+    TMR_SIM_advance(2ull * TMR_SIM_CLK_Hz);
+    CHECK(calls == 2);
+
+    TMR_deinit(handle);
+
+    TimerHandle_t * slave = Tmr_init(3, 0);
+    CHECK(slave != TMR_INVALID_HANDLE);
+    TMR_deinit(slave);
+}
+
+static void testStaleHandle(){
+    TimerHandle_t * old = Tmr_init(1, 0);
+    TMR_deinit(old);
+
+    TimerHandle_t * handle = Tmr_init(1, 0);
+    CHECK(handle != old);
+    CHECK(!TMR_isHandleAllocated(old));
+    CHECK(TMR_isHandleAllocated(handle));
+
+    //nothing done through the old handle may reach the new allocation
+    TMR_setPR(handle, 100);
+    TMR_setPR(old, 200);
+    CHECK(*TMR_getPRPointer(handle) == 100);
+    CHECK(TMR_getPRPointer(old) == NULL);
+
+    TMR_deinit(old);
+    CHECK(TMR_isHandleAllocated(handle));
+
+    TMR_deinit(handle);
+    CHECK(!TMR_isHandleAllocated(handle));
+}
+
+static void testIsrBinding(){
+    TimerHandle_t * handle = Tmr_init(1, 0);
+    uint32_t calls = 0;
+
+    CHECK(TMR_setISR(handle, testCountingIsr, &calls));
+    CHECK(!TMR_setISR(handle, testOtherIsr, NULL));
+
+    TimerIsrBinding_t old = TMR_swapISR(handle, testOtherIsr, NULL);
+    CHECK(old.function == testCountingIsr && old.data == &calls);
+    CHECK(TMR_getISR(handle).function == testOtherIsr);
+
+    //the next user of the timer must not inherit the callback
+    TMR_deinit(handle);
+    handle = Tmr_init(1, 0);
+    CHECK(TMR_getISR(handle).function == NULL);
+
+    TMR_deinit(handle);
+}
+
+#if TMR_PERIOD_QUEUE_SIZE > 0
+static void testPeriodQueue(){
+    TimerHandle_t * handle = Tmr_init(2, 0);
+    TMR_setPrescalerAndPR(handle, 0, 999);
+    TMR_setIRQEnabled(handle, 1);
+    TMR_setEnabled(handle, 1);
+
+    CHECK(TMR_queuePrescalerAndPR(handle, 0, 1999));
+    CHECK(TMR_queuePrescalerAndPR(handle, 1, 2999));
+    CHECK(TMR_getQueuedUpdateCount(handle) == 2);
+
+    //one entry per period match, the running period isn't cut short
+    TMR_SIM_advance(1000);
+    CHECK(*TMR_getPRPointer(handle) == 1999);
+    CHECK(TMR_getQueuedUpdateCount(handle) == 1);
+
+    TMR_SIM_advance(2000);
+    CHECK(*TMR_getPRPointer(handle) == 2999);
+    CHECK(TMR_getCountFrequency_Hz(handle) == TMR_SIM_CLK_Hz / 2);
+    CHECK(TMR_getQueuedUpdateCount(handle) == 0);
+
+    TMR_deinit(handle);
+}
+#endif
+
+#if TMR_ENABLE_SEQUENCER
+static void testSequence(){
+    static const uint32_t prValues[] = {999, 1999, 2999};
+    TimerSequence_t sequence = {.prValues = prValues, .length = 3, .mode = TmrSeqMode_OneShot};
+
+    TimerHandle_t * handle = Tmr_init(2, 0);
+    CHECK(TMR_setPeriod(handle, 1000));
+    CHECK(TMR_startSequence(handle, &sequence));
+    CHECK(TMR_isSequenceRunning(handle));
+
+    TMR_SIM_advance(1000);
+    CHECK(*TMR_getPRPointer(handle) == 1999);
+
+    //the sequence owns PR, a clock change only keeps the count rate
+    CHECK(TMR_getState(handle)->request == TMR_REQUEST_NONE);
+    TMR_notifyClockChange(2 * TMR_SIM_CLK_Hz);
+    CHECK(*TMR_getPRPointer(handle) == 1999);
+    TMR_notifyClockChange(TMR_SIM_CLK_Hz);
+
+    //a one shot sequence stops the timer at the end of its last step
+    TMR_SIM_advance(2000 + 3000);
+    CHECK(!TMR_isSequenceRunning(handle));
+    CHECK(!TMR_isEnabled(handle));
+
+    //and the period from before is the driver's again
+    TMR_notifyClockChange(2 * TMR_SIM_CLK_Hz);
+    CHECK(TMR_getPeriod_us(handle) == 1000);
+    TMR_notifyClockChange(TMR_SIM_CLK_Hz);
+
+    //same when the sequence is stopped
+    CHECK(TMR_startSequence(handle, &sequence));
+    TMR_stopSequence(handle);
+    CHECK(TMR_getState(handle)->request == TMR_REQUEST_PERIOD_US);
+
+    //the timer kept running, so the new period goes in at the next match
+    TMR_notifyClockChange(2 * TMR_SIM_CLK_Hz);
+    TMR_SIM_advance(1000);
+    CHECK(TMR_getPeriod_us(handle) == 1000);
+    TMR_notifyClockChange(TMR_SIM_CLK_Hz);
+
+    TMR_deinit(handle);
+}
+#endif
+
+static void testClockChange(){
+    TimerHandle_t * handle = Tmr_init(2, 0);
+    CHECK(TMR_setPeriod(handle, 1000));
+
+    //a requested period is solved again for the new clock, every time it changes
+    TMR_notifyClockChange(2 * TMR_SIM_CLK_Hz);
+    CHECK(TMR_getPeriod_us(handle) == 1000);
+    TMR_notifyClockChange(3 * TMR_SIM_CLK_Hz);
+    CHECK(TMR_getPeriod_us(handle) == 1000);
+    TMR_notifyClockChange(2 * TMR_SIM_CLK_Hz);
+
+    //a claimed PR is left alone, only the prescaler keeps the count rate
+    TMR_notifyClockChange(TMR_SIM_CLK_Hz);
+    TMR_claimPR(handle);
+    *TMR_getPRPointer(handle) = 12345;
+    uint32_t countRate = TMR_getCountFrequency_Hz(handle);
+
+    TMR_notifyClockChange(2 * TMR_SIM_CLK_Hz);
+    CHECK(*TMR_getPRPointer(handle) == 12345);
+    CHECK(TMR_getCountFrequency_Hz(handle) == countRate);
+
+    TMR_notifyClockChange(TMR_SIM_CLK_Hz);
+    TMR_deinit(handle);
+}
+
+static void testSoftTimerCallback(SoftTimer_t * timer, void * data){
+    (*(uint32_t *) data)++;
+}
+
+static void testSoftTimer(){
+    uint32_t calls = 0;
+    SoftTimer_t timer;
+    STMR_initTimer(&timer, testSoftTimerCallback, &calls);
+
+    //without a wheel nothing can be started
+    STMR_start(&timer, 5, 0);
+    CHECK(!STMR_isActive(&timer));
+
+    TimerHandle_t * handle = Tmr_init(1, 0);
+    TMR_setPeriod(handle, 1000);
+    CHECK(STMR_init(handle));
+
+    STMR_start(&timer, 5, 0);
+    CHECK(STMR_isActive(&timer));
+
+    TMR_SIM_advance(4 * 1000 * CYCLES_PER_us);
+    CHECK(calls == 0);
+    TMR_SIM_advance(1000 * CYCLES_PER_us);
+    CHECK(calls == 1);
+    CHECK(!STMR_isActive(&timer));
+
+    STMR_deinit();
+    TMR_deinit(handle);
+}
+
+static void testDeadlineCallback(TimerDeadline_t * deadline, void * data){
+    *(uint64_t *) data = TDL_now();
+}
+
+static void testDeadline(){
+    TimerHandle_t * handle = Tmr_init(2, 1);
+    TMR_setPrescaler(handle, 0);
+    CHECK(TDL_init(handle));
+
+    uint64_t firedAt = 0;
+    TimerDeadline_t deadline;
+    TDL_initDeadline(&deadline, testDeadlineCallback, &firedAt);
+
+    uint64_t due = TDL_now() + 1000;
+    CHECK(TDL_add(&deadline, due));
+
+    TMR_SIM_advance(999);
+    CHECK(firedAt == 0);
+    TMR_SIM_advance(100);
+    CHECK(firedAt >= due && firedAt < due + 100);
+    CHECK(!TDL_isPending(&deadline));
+
+    TDL_deinit();
+    TMR_deinit(handle);
+}
+
+static uint32_t testMisses = 0;
+
+static void testMissHandler(TimerWatchJob_t * job, void * data){
+    testMisses++;
+}
+
+static void testWatchdog(){
+    //nothing reaches the timer before TWD_init
+    TimerWatchJob_t early = TWD_JOB_INITIALIZER;
+    CHECK(TWD_register(&early, 100));
+    TWD_start(&early);
+    TWD_startBy(&early, 100);
+    CHECK(TWD_now() == 0);
+    CHECK(TWD_complete(&early) == 0);
+    CHECK(early.runs == 0);
+    TWD_unregister(&early);
+
+    TimerHandle_t * handle = Tmr_init(1, 0);
+    TMR_setPeriod(handle, 100);
+    CHECK(TWD_init(handle, testMissHandler, NULL));
+
+    //jobs that aren't registered are ignored
+    TimerWatchJob_t late = TWD_JOB_INITIALIZER;
+    TWD_start(&late);
+    CHECK(TWD_complete(&late) == 0);
+
+    TimerWatchJob_t onTime = TWD_JOB_INITIALIZER;
+    CHECK(TWD_register(&late, TWD_usToCounts(500)));
+    CHECK(TWD_register(&onTime, TWD_usToCounts(500)));
+    CHECK(!TWD_register(&onTime, TWD_usToCounts(500)));
+
+    testMisses = 0;
+    TWD_start(&late);
+    TWD_start(&onTime);
+
+    TMR_SIM_advance(200 * CYCLES_PER_us);
+    CHECK(TWD_complete(&onTime) == 1);
+
+    TMR_SIM_advance(1000 * CYCLES_PER_us);
+    CHECK(testMisses == 1);
+    CHECK(TWD_complete(&late) == 0);
+    CHECK(late.misses == 1 && onTime.misses == 0);
+
+    TWD_unregister(&late);
+    TWD_unregister(&onTime);
+    TWD_deinit();
+    CHECK(TWD_now() == 0);
+    TMR_deinit(handle);
+}
+
+static uint32_t testDeferredCalls = 0;
+static uint32_t testDeferredLast = 0;
+
+static void testDeferredCallback(TimerHandle_t * handle, uint32_t timestamp, void * data){
+    //the events of one ring come out in the order the interrupts happened
+    if(testDeferredCalls > 0 && (int32_t) (timestamp - testDeferredLast) <= 0) (*(uint32_t *) data)++;
+    testDeferredLast = timestamp;
+    testDeferredCalls++;
+}
+
+static void testDefer(){
+    TimerHandle_t * handle = Tmr_init(2, 0);
+    TMR_setPeriod(handle, 100);
+
+    uint32_t outOfOrder = 0;
+    TimerDeferred_t deferred;
+    CHECK(TDEF_attach(&deferred, handle, testDeferredCallback, &outOfOrder));
+    TMR_setIRQEnabled(handle, 1);
+    TMR_setEnabled(handle, 1);
+
+    //the interrupts only queue events, the callbacks run from TDEF_process
+    testDeferredCalls = 0;
+    TMR_SIM_advance(3 * 100 * CYCLES_PER_us);
+    CHECK(testDeferredCalls == 0);
+    CHECK(TDEF_process() == 3);
+    CHECK(testDeferredCalls == 3);
+    CHECK(outOfOrder == 0);
+    CHECK(TDEF_process() == 0);
+
+    //a full ring drops the newest events and counts them
+    TMR_SIM_advance((TDEF_RING_SIZE + 2) * 100 * CYCLES_PER_us);
+    CHECK(deferred.dropped == 2);
+    CHECK(TDEF_process() == TDEF_RING_SIZE);
+
+    //events still queued when the timer is detached don't call anything anymore
+    TMR_SIM_advance(100 * CYCLES_PER_us);
+    TDEF_detach(&deferred);
+    testDeferredCalls = 0;
+    TDEF_process();
+    CHECK(testDeferredCalls == 0);
+    CHECK(TMR_getISR(handle).function == NULL);
+
+    TMR_deinit(handle);
+}
+
+#if TMR_ENABLE_ISR_STATS && TMR_PERIOD_QUEUE_SIZE > 0
+static uint32_t testSlowIsr(TimerHandle_t * handle, uint32_t flags, void * data){
+    //pretend the callback took 100 counts
+    *TMR_getTMRPointer(handle) += 100;
+    return 0;
+}
+
+static void testIsrStats(){
+    TimerHandle_t * handle = Tmr_init(2, 0);
+    TMR_setPrescalerAndPR(handle, 0, 999);
+    TMR_setISR(handle, testSlowIsr, NULL);
+    TMR_setEnabled(handle, 1);
+
+    //let the interrupt come in 50 clocks late, together with a switch to prescaler 2 (divide by 4) at that match
+    CHECK(TMR_queuePrescalerAndPR(handle, 2, 999));
+    TMR_SIM_advance(1000 + 50);
+    TMR_setIRQEnabled(handle, 1);
+    TMR_SIM_dispatchPending();
+
+    TimerIsrStats_t stats;
+    CHECK(TMR_getIsrStats(handle, &stats));
+    CHECK(stats.latency.count == 1);
+
+    //the latency was counted with the old prescaler, the callback ran with the new one
+    CHECK(stats.latency.max == 50);
+    CHECK(stats.duration.max == 100 << 2);
+
+    //the next interrupt is on time, which is a jitter of 50
+    TMR_SIM_advance(4 * 1000);
+    CHECK(TMR_getIsrStats(handle, &stats));
+    CHECK(stats.latency.count == 2);
+    CHECK(stats.latency.min == 0 && stats.latency.mean == 25);
+    CHECK(stats.jitter.count == 1 && stats.jitter.max == 50);
+    CHECK(stats.latency.histogram[0] == 1 && stats.latency.histogram[6] == 1);
+
+    TMR_resetIsrStats(handle);
+    CHECK(TMR_getIsrStats(handle, &stats));
+    CHECK(stats.latency.count == 0 && stats.duration.count == 0);
+
+    TMR_deinit(handle);
+}
+#endif
+
+static void testDeadlineLifetime(){
+    TimerDeadline_t deadline;
+    TDL_initDeadline(&deadline, NULL, NULL);
+
+    //nothing may touch the timer before TDL_init
+    CHECK(TDL_now() == 0);
+    CHECK(!TDL_add(&deadline, 100));
+    CHECK(!TDL_addIn(&deadline, 100));
+    TDL_cancel(&deadline);
+
+    TimerHandle_t * handle = Tmr_init(2, 1);
+    TMR_setPrescaler(handle, 0);
+    CHECK(TDL_init(handle));
+
+    //a match that is still pending is already part of the time, even with the isr held off
+    uint64_t firedAt = 0;
+    TimerDeadline_t early;
+    TDL_initDeadline(&early, testDeadlineCallback, &firedAt);
+    CHECK(TDL_add(&early, 1000));
+    TMR_setIRQEnabled(handle, 0);
+    TMR_SIM_advance(1500);
+    CHECK(TMR_readIFS(handle));
+    CHECK(TDL_now() == 1500);
+
+    //reprogramming with the match pending leaves it to the isr, which still advances by the period that ended
+    CHECK(TDL_add(&deadline, 5000));
+    TMR_setIRQEnabled(handle, 1);
+    TMR_SIM_dispatchPending();
+    CHECK(firedAt == 1500);
+    CHECK(TDL_now() == 1500);
+    TMR_SIM_advance(100);
+    CHECK(TDL_now() == 1600);
+    TMR_SIM_advance(3400);
+    CHECK(!TDL_isPending(&deadline));
+
+    //and everything is rejected again after TDL_deinit
+    CHECK(TDL_add(&deadline, 1000000));
+    TDL_deinit();
+    CHECK(!TDL_isPending(&deadline));
+    CHECK(TDL_now() == 0);
+    CHECK(!TDL_add(&deadline, 100));
+    TDL_cancel(&deadline);
+
+    TMR_deinit(handle);
+}
+
+static void testGroup(){
+    TimerHandle_t * first = Tmr_init(1, 0);
+    TimerHandle_t * second = Tmr_init(2, 0);
+    TMR_setPrescaler(first, 0);
+    TMR_setPrescaler(second, 0);
+    TMR_setPR(first, 999);
+    TMR_setPR(second, 999);
+
+    TimerGroup_t group;
+    TGRP_init(&group);
+    CHECK(TGRP_add(&group, first, 0));
+    CHECK(TGRP_add(&group, second, 1250));
+    CHECK(!TGRP_add(&group, second, 0));
+
+    //the phase is wrapped into the period and kept across a stop
+    TGRP_start(&group);
+    TMR_SIM_advance(100);
+    CHECK(*TMR_getTMRPointer(first) == 100);
+    CHECK(*TMR_getTMRPointer(second) == 350);
+
+    TGRP_stop(&group);
+    TMR_SIM_advance(100);
+    CHECK(*TMR_getTMRPointer(first) == 100);
+    CHECK(*TMR_getTMRPointer(second) == 350);
+
+    TGRP_resume(&group);
+    TMR_SIM_advance(50);
+    CHECK(*TMR_getTMRPointer(first) == 150);
+    CHECK(*TMR_getTMRPointer(second) == 400);
+
+    //a member freed without being removed must not reach whoever has its timer now
+    TMR_deinit(first);
+    TimerHandle_t * other = Tmr_init(1, 0);
+    TMR_setPrescaler(other, 0);
+    TMR_setPR(other, 0xffff);
+    TMR_setEnabled(other, 1);
+
+    TGRP_stop(&group);
+    TMR_SIM_advance(100);
+    CHECK(*TMR_getTMRPointer(other) == 100);
+    CHECK(*TMR_getTMRPointer(second) == 400);
+
+    TGRP_start(&group);
+    TMR_SIM_advance(100);
+    CHECK(*TMR_getTMRPointer(other) == 200);
+    CHECK(*TMR_getTMRPointer(second) == 350);
+
+    CHECK(TGRP_remove(&group, first));
+    CHECK(!TGRP_remove(&group, first));
+
+    TGRP_stop(&group);
+    TMR_deinit(other);
+    TMR_deinit(second);
+}
+
+static void testMeasure(){
+    TimerHandle_t * counter = Tmr_init(2, 0);
+    TimerHandle_t * window = Tmr_init(1, 0);
+    TimerMeasure_t measure;
+
+    //an isr that is already bound is kept and nothing is left running
+    uint32_t calls = 0;
+    TMR_setISR(window, testCountingIsr, &calls);
+    CHECK(!TMS_init(&measure, TmsMode_Frequency, counter, window, 1000));
+    CHECK(TMR_getISR(window).function == testCountingIsr);
+    CHECK(TMR_getISR(counter).function == NULL);
+    CHECK(!TMR_isEnabled(counter) && !TMR_isEnabled(window));
+    TMR_setISR(window, NULL, NULL);
+
+    TMR_setISR(counter, testCountingIsr, &calls);
+    CHECK(!TMS_init(&measure, TmsMode_Frequency, counter, window, 1000));
+    CHECK(TMR_getISR(counter).function == testCountingIsr);
+    CHECK(TMR_getISR(window).function == NULL);
+    TMR_setISR(counter, NULL, NULL);
+
+    //external clocks aren't simulated, so the edges are put into the counter by hand
+    CHECK(TMS_init(&measure, TmsMode_Frequency, counter, window, 1000));
+    CHECK(TMS_getFrequency_mHz(&measure) == 0);
+    *TMR_getTMRPointer(counter) = 1000;
+    TMR_SIM_advance(1000 * CYCLES_PER_us);
+    *TMR_getTMRPointer(counter) = 1500;
+    TMR_SIM_advance(1000 * CYCLES_PER_us);
+    CHECK(measure.filled == 2);
+    CHECK(TMS_getFrequency_mHz(&measure) == 750000000);
+    TMS_deinit(&measure);
+    CHECK(TMR_getISR(counter).function == NULL && TMR_getISR(window).function == NULL);
+
+    //and the gate is always high, so the counter sees the whole window
+    CHECK(TMS_init(&measure, TmsMode_PulseWidth, counter, window, 1000));
+    TMR_SIM_advance(4000 * CYCLES_PER_us);
+    CHECK(measure.filled == 4);
+    CHECK(TMS_getDutyCycle_ppm(&measure) >= 999000);
+    CHECK(TMS_getPulseWidth_ns(&measure) == 0);
+    TMS_deinit(&measure);
+
+    TMR_deinit(window);
+    TMR_deinit(counter);
+}
+
+static void testDelay(){
+    //nothing is touched without a timer
+    uint64_t start = TMR_SIM_getCycles();
+    TDLY_delay_us(100);
+    TDLY_delayUntil(1000);
+    CHECK(TDLY_now() == 0);
+    CHECK(TMR_SIM_getCycles() == start);
+
+    TimerHandle_t * handle = Tmr_init(2, 0);
+    TMR_setPrescaler(handle, 0);
+    CHECK(TDLY_init(handle));
+    CHECK(!TDLY_init(handle));
+    CHECK(TDLY_usToTicks(1) == CYCLES_PER_us);
+
+    start = TMR_SIM_getCycles();
+    TDLY_delay_us(100);
+    CHECK(TMR_SIM_getCycles() - start == 100 * CYCLES_PER_us);
+
+    //longer than the 16bit counter wraps
+    start = TMR_SIM_getCycles();
+    TDLY_delay_us(5000);
+    CHECK(TMR_SIM_getCycles() - start == 5000 * CYCLES_PER_us);
+
+    start = TMR_SIM_getCycles();
+    TDLY_delayUntil((TDLY_now() + 1000) & 0xffff);
+    CHECK(TMR_SIM_getCycles() - start == 1000);
+
+    TDLY_deinit();
+    start = TMR_SIM_getCycles();
+    TDLY_delay_us(100);
+    CHECK(TDLY_now() == 0);
+    CHECK(TMR_SIM_getCycles() == start);
+
+    TMR_deinit(handle);
+}
+
+static void testConfigure(){
+    TimerHandle_t * handle = Tmr_init(2, 0);
+    const TimerDescriptor_t * desc = TMR_getState(handle)->descriptor;
+    uint32_t calls = 0;
+    TMR_setISR(handle, testCountingIsr, &calls);
+
+    TimerSetup_t setup = {.prescaler = 3, .prValue = 999, .mode = TmrMode_freeRunning, .priority = 5, .subPriority = 2, .irqEnabled = 1, .enabled = 1};
+    TMR_configure(handle, &setup);
+    CHECK(desc->registerMap->TCON.w == (_T1CON_TON_MASK | (3 << TMR_TCKPS_POSITION)));
+    CHECK(desc->registerMap->PR == 999);
+    CHECK(((desc->ipcReg->w >> desc->ipcOffset) & TMR_PRIORITY_MASK) == ((5 << 2) | 2));
+    CHECK(TMR_isIRQEnabled(handle));
+
+    TMR_SIM_advance(1000 * 8);
+    CHECK(calls == 1);
+
+    //a running timer is reconfigured without being left off
+    setup.prescaler = 2;
+    setup.prValue = 499;
+    TMR_configure(handle, &setup);
+    CHECK(desc->registerMap->TCON.w == (_T1CON_TON_MASK | (2 << TMR_TCKPS_POSITION)));
+    TMR_SIM_advance(500 * 4);
+    CHECK(calls == 2);
+
+    //and one that is switched off gets everything else anyway
+    setup.enabled = 0;
+    setup.irqEnabled = 0;
+    setup.clockSource = 1;
+    TMR_configure(handle, &setup);
+    CHECK(desc->registerMap->TCON.w == (TMR_TCS_MASK | (2 << TMR_TCKPS_POSITION)));
+    CHECK(!TMR_isIRQEnabled(handle));
+
+#if TMR_ENABLE_REG_TRACE
+    //a prescaler change on a running timer must not count with the bits the old and the new prescaler have in common
+    TMR_setClockSource(handle, 0, 0, 0);
+    TMR_setPrescaler(handle, 1);
+    TMR_setEnabled(handle, 1);
+
+    TimerTraceRecord_t records[4];
+    TMR_traceReset();
+    TMR_traceSetLogging(1);
+    TMR_setPrescaler(handle, 2);
+    TMR_traceSetLogging(0);
+
+    uint32_t count = TMR_traceGetRecords(records, 4);
+    CHECK(count == 2);
+    CHECK(records[0].address == &desc->registerMap->TCONCLR.w && (records[0].value & _T1CON_TON_MASK));
+    CHECK(records[1].address == &desc->registerMap->TCONSET.w && (records[1].value & _T1CON_TON_MASK));
+    CHECK(desc->registerMap->TCON.w == (_T1CON_TON_MASK | (2 << TMR_TCKPS_POSITION)));
+#endif
+
+    TMR_deinit(handle);
+}
+
+static uint32_t testHookCalls = 0;
+
+static void testClockHook(uint32_t oldClock_Hz, uint32_t newClock_Hz){
+    testHookCalls++;
+}
+
+static void testClockHooks(){
+    //a hook is only registered once, and the slots run out
+    testHookCalls = 0;
+    CHECK(TMR_addClockHook(testClockHook));
+    CHECK(TMR_addClockHook(testClockHook));
+    TMR_notifyClockChange(2 * TMR_SIM_CLK_Hz);
+    CHECK(testHookCalls == 1);
+    TMR_notifyClockChange(TMR_SIM_CLK_Hz);
+    TMR_removeClockHook(testClockHook);
+    TMR_notifyClockChange(2 * TMR_SIM_CLK_Hz);
+    TMR_notifyClockChange(TMR_SIM_CLK_Hz);
+    CHECK(testHookCalls == 2);
+
+    TimerHandle_t * timestamp = Tmr_init(2, 1);
+    TimerHandle_t * delay = Tmr_init(4, 0);
+    TimerHandle_t * watchdog = Tmr_init(1, 0);
+    TMR_setPrescaler(timestamp, 0);
+    TMR_setPrescaler(delay, 0);
+    TMR_setPrescaler(watchdog, 0);
+    TMR_setPR(watchdog, 39999);
+    CHECK(TTS_init(timestamp));
+    CHECK(TDLY_init(delay));
+    CHECK(TWD_init(watchdog, NULL, NULL));
+
+    TimerWatchJob_t job = TWD_JOB_INITIALIZER;
+    CHECK(TWD_register(&job, TWD_usToCounts(500)));
+    CHECK(job.budget == 500 * CYCLES_PER_us);
+
+    TMR_SIM_advance(1000 * CYCLES_PER_us);
+    uint64_t time_us = TTS_getUs();
+    CHECK(time_us == 1000);
+
+    //by a power of two the prescalers keep every count rate
+    TMR_notifyClockChange(2 * TMR_SIM_CLK_Hz);
+    CHECK(TTS_getTickFrequency_Hz() == TMR_SIM_CLK_Hz);
+    CHECK(TTS_getUs() == time_us);
+    TMR_notifyClockChange(TMR_SIM_CLK_Hz);
+
+    //anything else changes them, the simulator keeps counting at its own rate, which the driver now takes for 60MHz
+    TMR_notifyClockChange(TMR_SIM_CLK_Hz / 2 * 3);
+    CHECK(TTS_getTickFrequency_Hz() == TMR_SIM_CLK_Hz / 2 * 3);
+    CHECK(TTS_getUs() == time_us);
+    TMR_SIM_advance(1500 * CYCLES_PER_us);
+    CHECK(TTS_getUs() - time_us == 1000);
+
+    CHECK(TDLY_usToTicks(1) == CYCLES_PER_us / 2 * 3);
+    CHECK(TWD_usToCounts(500) == 500 * CYCLES_PER_us / 2 * 3);
+    CHECK(job.budget == 500 * CYCLES_PER_us / 2 * 3);
+
+    TMR_notifyClockChange(TMR_SIM_CLK_Hz);
+    CHECK(TDLY_usToTicks(1) == CYCLES_PER_us);
+    CHECK(job.budget == 500 * CYCLES_PER_us);
+
+    TWD_unregister(&job);
+    TWD_deinit();
+    TDLY_deinit();
+    TTS_deinit();
+    TMR_deinit(watchdog);
+    TMR_deinit(delay);
+    TMR_deinit(timestamp);
+}
+
+static void testTickless(){
+    //the rtos tick of the simulated kernel comes from timer 1
+    uint32_t ticks = 0;
+    TimerHandle_t * tick = Tmr_init(1, 0);
+    CHECK(TMR_setPeriod(tick, 1000000 / configTICK_RATE_HZ));
+    TMR_setISR(tick, testCountingIsr, &ticks);
+    TMR_setIRQEnabled(tick, 1);
+    TMR_setEnabled(tick, 1);
+
+    TimerHandle_t * wake = Tmr_init(2, 1);
+    TMR_setPrescaler(wake, 0);
+    CHECK(TTL_init(wake));
+
+    //10us into a tick, sleeping through 10 of them ends right before the 10th. That one is left to the tick isr
+    uint32_t cyclesPerTick = TMR_SIM_CLK_Hz / configTICK_RATE_HZ;
+    TMR_SIM_advance(10 * CYCLES_PER_us);
+    uint64_t start = TMR_SIM_getCycles();
+    TTL_suppressTicksAndSleep(10);
+    CHECK(TMR_SIM_getCycles() - start == 10 * cyclesPerTick - 10 * CYCLES_PER_us - TTL_OVERHEAD_CYCLES);
+    CHECK(TMR_SIM_getSteppedTicks() == 9);
+    CHECK(TTL_getSleptTicks() == 9);
+    CHECK(ticks == 0);
+
+    //the tick timer kept its phase, and the tick that was flagged while it was masked still comes in.
+    //The simulator doesn't spend TTL_OVERHEAD_CYCLES getting here, so the 10th tick is still that far away
+    CHECK(*TMR_getTMRPointer(tick) == cyclesPerTick - TTL_OVERHEAD_CYCLES);
+    TMR_SIM_dispatchPending();
+    CHECK(ticks == 1);
+
+    //no sleep if the kernel says so or it isn't worth it
+    start = TMR_SIM_getCycles();
+    TMR_SIM_setSleepStatus(eAbortSleep);
+    TTL_suppressTicksAndSleep(10);
+    TMR_SIM_setSleepStatus(eStandardSleep);
+    TTL_suppressTicksAndSleep(TTL_MIN_IDLE_TICKS - 1);
+    CHECK(TMR_SIM_getCycles() == start);
+    CHECK(TMR_SIM_getSteppedTicks() == 9);
+
+    TTL_deinit();
+    TMR_deinit(wake);
+    TMR_deinit(tick);
+}
+
+#if TMR_ENABLE_REG_TRACE
+static char testDumpText[2048];
+static uint32_t testDumpLength = 0;
+
+static int testDumpPrint(const char * format, ...){
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(testDumpText + testDumpLength, sizeof(testDumpText) - testDumpLength, format, args);
+    va_end(args);
+    if(length > 0 && testDumpLength + length < sizeof(testDumpText)) testDumpLength += length;
+    return length;
+}
+
+static void testTrace(){
+    TimerHandle_t * handle = Tmr_init(2, 0);
+    const TimerDescriptor_t * desc = TMR_getState(handle)->descriptor;
+    TMR_traceReset();
+    TMR_traceSetLogging(1);
+
+    //a PR write of a stopped timer reads the counter back once
+    TimerTraceCounts_t counts;
+    TMR_TRACE_CALL("setPR", &counts, TMR_setPR(handle, 100));
+    CHECK(counts.reads == 1 && counts.writes == 1 && counts.redundantWrites == 0);
+
+    //the same value again changes nothing
+    TMR_TRACE_CALL("setPR again", &counts, TMR_setPR(handle, 100));
+    CHECK(counts.writes == 1 && counts.redundantWrites == 1);
+
+    //so does setting the on bit of a running timer
+    TMR_TRACE_CALL("enable", &counts, TMR_setEnabled(handle, 1));
+    CHECK(counts.writes == 1 && counts.redundantWrites == 0);
+    TMR_TRACE_CALL("enable again", &counts, TMR_setEnabled(handle, 1));
+    CHECK(counts.writes == 1 && counts.redundantWrites == 1);
+
+    //the records carry the label of their call, oldest first
+    TimerTraceRecord_t records[8];
+    uint32_t count = TMR_traceGetRecords(records, 8);
+    CHECK(count == 6);
+    CHECK(records[0].label != NULL && records[0].address == &desc->registerMap->PR && records[0].value == 100 && records[0].type == TMR_TRACE_WRITE);
+    CHECK(records[1].type == TMR_TRACE_READ && records[1].address == &desc->registerMap->TMR);
+    CHECK(records[2].address == &desc->registerMap->PR && records[2].type == (TMR_TRACE_WRITE | TMR_TRACE_REDUNDANT));
+    CHECK(records[5].address == &desc->registerMap->TCONSET.w && records[5].type == (TMR_TRACE_WRITE | TMR_TRACE_REDUNDANT));
+
+    //the totals add up every call since the reset
+    TimerTraceCounts_t totals;
+    TMR_traceGetTotals(&totals);
+    CHECK(totals.reads == 2 && totals.writes == 4 && totals.redundantWrites == 2);
+
+    //one line per record and the totals
+    testDumpLength = 0;
+    TMR_traceDump(testDumpPrint);
+    CHECK(strstr(testDumpText, "setPR: ") != NULL);
+    CHECK(strstr(testDumpText, "total: 2 reads, 4 writes, 2 redundant\n") != NULL);
+
+    //a reset drops the records and the totals, with logging off only the counts remain
+    TMR_traceReset();
+    TMR_traceSetLogging(0);
+    TMR_setPR(handle, 200);
+    TMR_traceGetTotals(&totals);
+    CHECK(TMR_traceGetRecords(records, 8) == 0);
+    CHECK(totals.writes == 1);
+
+    TMR_traceSetLogging(1);
+    TMR_deinit(handle);
+}
+#endif
+
+static void testTimestamp(){
+    TimerHandle_t * handle = Tmr_init(2, 1);
+    TimerHandle_t * single = Tmr_init(1, 0);
+    CHECK(!TTS_init(single));
+    TMR_deinit(single);
+    CHECK(TTS_init(handle));
+    CHECK(!TTS_init(handle));
+    CHECK(TTS_getTickFrequency_Hz() == TMR_SIM_CLK_Hz);
+
+    //counts at the peripheral clock from 0
+    CHECK(TTS_getTicks() == 0);
+    TMR_SIM_advance(1000 * CYCLES_PER_us);
+    CHECK(TTS_getTicks() == 1000 * CYCLES_PER_us);
+    CHECK(TTS_getUs() == 1000);
+    CHECK(TTS_getNs() == 1000000);
+
+    //the conversions are exact for whole us at this rate
+    CHECK(TTS_ticksToUs(CYCLES_PER_us) == 1);
+    CHECK(TTS_ticksToNs(CYCLES_PER_us) == 1000);
+
+    //long spans are off by the precision of the factor only, a few hundred us in an hour
+    CHECK(TTS_ticksToUs((uint64_t) TMR_SIM_CLK_Hz * 3600) - 3600000000ull < 1000);
+
+    //a wrap whose interrupt hasn't run yet is counted already
+    uint32_t * counter = TMR_getTMRPointer(handle);
+    *counter = 0xfffffff0;
+    TMR_SIM_wait();
+    uint64_t ticks = TTS_getTicks();
+    CHECK(ticks >= 0x100000000ull && ticks < 0x100000100ull);
+
+    //and not twice once it has
+    TMR_SIM_dispatchPending();
+    CHECK(TTS_getTicks() == ticks);
+    TMR_SIM_advance(100);
+    CHECK(TTS_getTicks() == ticks + 100);
+
+    //a flag set for a counter that hasn't wrapped yet is read as not pending
+    *counter = 0xffffff00;
+    TMR_SIM_wait();
+    *counter = 0xffffff00;
+    CHECK(TTS_getTicks() == 0x1ffffff00ull);
+    TMR_SIM_dispatchPending();
+
+    TTS_deinit();
+    TMR_deinit(handle);
+}
+
+static uint32_t testExecOverrun = 0;
+
+static void testExecJob(void * data){
+    (*(uint32_t *) data)++;
+
+    //pretend the job took longer than a frame
+    if(testExecOverrun){
+        testExecOverrun = 0;
+        Tmr_TimerMap[0].ifsReg->SET = Tmr_TimerMap[0].intMask;
+        TMR_SIM_sync();
+    }
+}
+
+static void testExec(){
+    TimerHandle_t * handle = Tmr_init(1, 0);
+    CHECK(TMR_setPeriod(handle, 100));
+    CHECK(TCE_init(handle));
+    CHECK(!TCE_init(handle));
+
+    uint32_t fastRuns = 0;
+    uint32_t slowRuns = 0;
+    uint32_t otherRuns = 0;
+    TimerJob_t fast;
+    TimerJob_t slow;
+    TimerJob_t other;
+    CHECK(TCE_addJob(&slow, testExecJob, &slowRuns, 10));
+    CHECK(TCE_addJob(&fast, testExecJob, &fastRuns, 1));
+    CHECK(TCE_addJob(&other, testExecJob, &otherRuns, 10));
+    CHECK(!TCE_addJob(&fast, testExecJob, &fastRuns, 2));
+    CHECK(!TCE_addJob(&fast, testExecJob, &fastRuns, 0));
+
+    //the two slow jobs don't share a frame
+    CHECK(slow.phase != other.phase);
+
+    TMR_SIM_advance(100 * 100 * CYCLES_PER_us);
+    CHECK(fastRuns == 100 && fast.runs == 100);
+    CHECK(slowRuns == 10 && otherRuns == 10);
+
+    TimerExecStats_t stats;
+    TCE_getStats(&stats);
+    CHECK(stats.frames == 100);
+    CHECK(stats.overruns == 0);
+    CHECK(stats.worstFrame < 100 * CYCLES_PER_us);
+
+    //an overrun is blamed on the job that was running, the fast one runs first
+    testExecOverrun = 1;
+    TMR_SIM_advance(100 * CYCLES_PER_us);
+    TCE_getStats(&stats);
+    CHECK(stats.overruns == 1);
+    CHECK(fast.overruns == 1 && slow.overruns == 0 && other.overruns == 0);
+
+    TCE_resetStats();
+    TCE_getStats(&stats);
+    CHECK(stats.frames == 0 && stats.overruns == 0 && stats.worstFrame == 0);
+
+    //a removed job doesn't run anymore
+    TCE_removeJob(&fast);
+    TMR_SIM_advance(10 * 100 * CYCLES_PER_us);
+    CHECK(fast.runs == 101 || fast.runs == 102);
+    uint32_t runs = fast.runs;
+    TMR_SIM_advance(10 * 100 * CYCLES_PER_us);
+    CHECK(fast.runs == runs);
+
+    TCE_removeJob(&slow);
+    TCE_removeJob(&other);
+    TCE_deinit();
+    TMR_deinit(handle);
+}
+
+static void testInitAny(){
+    //without requirements the slaves go first, then the masters and type A last
+    TimerRequirements_t any = {0};
+    TimerHandle_t * handles[TMR_SIM_NUM_TIMERS];
+    uint32_t order[TMR_SIM_NUM_TIMERS] = {3, 5, 2, 4, 1};
+    for(uint32_t i = 0; i < TMR_SIM_NUM_TIMERS; i++){
+        handles[i] = Tmr_initAny(&any);
+        CHECK(handles[i] != TMR_INVALID_HANDLE && TMR_getState(handles[i])->number == order[i]);
+    }
+    CHECK(Tmr_initAny(&any) == TMR_INVALID_HANDLE);
+    for(uint32_t i = 0; i < TMR_SIM_NUM_TIMERS; i++) TMR_deinit(handles[i]);
+
+    //a 32bit pair needs a master with a free slave
+    TimerHandle_t * slave = Tmr_init(3, 0);
+    TimerRequirements_t pair = {.need32Bit = 1};
+    TimerHandle_t * handle = Tmr_initAny(&pair);
+    CHECK(handle != TMR_INVALID_HANDLE && TMR_getState(handle)->number == 4);
+    CHECK(Tmr_initAny(&pair) == TMR_INVALID_HANDLE);
+    TMR_deinit(handle);
+    TMR_deinit(slave);
+
+    //only type A counts asynchronously
+    TimerRequirements_t async = {.needAsyncClock = 1, .maxPeriod_us = 100000};
+    handle = Tmr_initAny(&async);
+    CHECK(handle != TMR_INVALID_HANDLE && TMR_getState(handle)->number == 1);
+    TMR_deinit(handle);
+
+    //1s is out of reach of every 16bit timer, but not of a pair
+    TimerRequirements_t slow = {.maxPeriod_us = 1000000};
+    CHECK(Tmr_initAny(&slow) == TMR_INVALID_HANDLE);
+    slow.need32Bit = 1;
+    handle = Tmr_initAny(&slow);
+    CHECK(handle != TMR_INVALID_HANDLE && TMR_getState(handle)->number == 2);
+    TMR_deinit(handle);
+
+    //a resolution of one clock rules out every prescaler, so only periods up to a full 16bit count work
+    TimerRequirements_t fine = {.maxPeriod_us = 1000, .resolution_ns = 25};
+    handle = Tmr_initAny(&fine);
+    CHECK(handle != TMR_INVALID_HANDLE);
+    TMR_deinit(handle);
+    fine.maxPeriod_us = 2000;
+    CHECK(Tmr_initAny(&fine) == TMR_INVALID_HANDLE);
+
+    //the interrupt priority is set on the timer that was picked
+    TimerRequirements_t irq = {.irqPriority = 5};
+    handle = Tmr_initAny(&irq);
+    CHECK(handle != TMR_INVALID_HANDLE);
+    const TimerDescriptor_t * desc = TMR_getState(handle)->descriptor;
+    CHECK(((desc->ipcReg->w >> desc->ipcOffset) & TMR_PRIORITY_MASK) == (5 << 2));
+    TMR_deinit(handle);
+    irq.irqPriority = 8;
+    CHECK(Tmr_initAny(&irq) == TMR_INVALID_HANDLE);
+}
+
+static void testDeadlineSlack(){
+    TimerHandle_t * handle = Tmr_init(2, 1);
+    TMR_setPrescaler(handle, 0);
+    CHECK(TDL_init(handle));
+
+    uint64_t firedEarly = 0;
+    uint64_t firedLate = 0;
+    uint64_t firedExact = 0;
+    TimerDeadline_t early;
+    TimerDeadline_t late;
+    TimerDeadline_t exact;
+    TDL_initDeadline(&early, testDeadlineCallback, &firedEarly);
+    TDL_initDeadline(&late, testDeadlineCallback, &firedLate);
+    TDL_initDeadline(&exact, testDeadlineCallback, &firedExact);
+
+    //the early deadline may wait for the late one, both fire in one interrupt
+    uint64_t now = TDL_now();
+    TDL_setSlack(&early, 500);
+    CHECK(TDL_add(&early, now + 1000));
+    CHECK(TDL_add(&late, now + 1300));
+    CHECK(TDL_add(&exact, now + 5000));
+
+    TMR_SIM_advance(1200);
+    CHECK(firedEarly == 0);
+    TMR_SIM_advance(200);
+    CHECK(firedEarly >= now + 1300 && firedEarly < now + 1400);
+    CHECK(firedLate == firedEarly);
+
+    //without slack a deadline fires on time
+    TMR_SIM_advance(3500);
+    CHECK(firedExact == 0);
+    TMR_SIM_advance(200);
+    CHECK(firedExact >= now + 5000 && firedExact < now + 5100);
+
+    TimerDeadlineStats_t stats;
+    TDL_getStats(&stats);
+    CHECK(stats.expiries == 3);
+    CHECK(stats.coalesced == 1);
+    CHECK(stats.interrupts == 2);
+
+    //the slack only stretches a deadline, one with nothing to share with still fires before its slack runs out
+    TDL_resetStats();
+    firedEarly = 0;
+    now = TDL_now();
+    CHECK(TDL_add(&early, now + 1000));
+    TMR_SIM_advance(1600);
+    CHECK(firedEarly >= now + 1000 && firedEarly <= now + 1500);
+
+    TDL_getStats(&stats);
+    CHECK(stats.expiries == 1 && stats.coalesced == 0);
+
+    TDL_deinit();
+    TMR_deinit(handle);
+}
+
+//resolved by the compiler, the file scope makes sure of that
+static const TmrConstConfig_t testConstA = TMR_CONST_PERIOD_US(TmrType_A, 0, 10000);
+static const TmrConstConfig_t testConstB = TMR_CONST_PERIOD_US(TmrType_B_Master, 0, 10000);
+static const TmrConstConfig_t testConstPair = TMR_CONST_PERIOD_US(TmrType_B_Master, 1, 1000000);
+static const TmrConstConfig_t testConstShort = TMR_CONST_PERIOD_NS(TmrType_B_Slave, 0, 500);
+static const TmrConstConfig_t testConstFrequency = TMR_CONST_FREQUENCY_mHz(TmrType_A, 0, 1000000);
+
+static uint32_t testPrescalerOf(TimerHandle_t * handle){
+    return (TMR_getState(handle)->descriptor->registerMap->TCON.w >> TMR_TCKPS_POSITION) & 7;
+}
+
+static void testConst(){
+    //the type A prescaler steps are 1, 8, 64 and 256, type B has every power of two up to 64 and then 256
+    CHECK(testConstA.prescaler == 1 && testConstA.pr == 10000 * CYCLES_PER_us / 8 - 1);
+    CHECK(testConstB.prescaler == 3 && testConstB.pr == 10000 * CYCLES_PER_us / 8 - 1);
+    CHECK(testConstPair.prescaler == 0 && testConstPair.pr == TMR_SIM_CLK_Hz - 1);
+    CHECK(testConstShort.prescaler == 0 && testConstShort.pr == 500 * CYCLES_PER_us / 1000 - 1);
+    CHECK(testConstFrequency.prescaler == 0 && testConstFrequency.pr == 1000 * CYCLES_PER_us - 1);
+
+    //and they agree with what the driver works out at runtime
+    TimerHandle_t * typeA = Tmr_init(1, 0);
+    TimerHandle_t * pair = Tmr_init(2, 1);
+    TimerHandle_t * typeB = Tmr_init(4, 0);
+
+    CHECK(TMR_setPeriod(typeA, 10000));
+    CHECK(testPrescalerOf(typeA) == testConstA.prescaler && *TMR_getPRPointer(typeA) == testConstA.pr);
+    CHECK(TMR_setPeriod(typeB, 10000));
+    CHECK(testPrescalerOf(typeB) == testConstB.prescaler && *TMR_getPRPointer(typeB) == testConstB.pr);
+    CHECK(TMR_setPeriod(pair, 1000000));
+    CHECK(testPrescalerOf(pair) == testConstPair.prescaler && *TMR_getPRPointer(pair) == testConstPair.pr);
+
+    //applying one writes both fields
+    TMR_applyConstConfig(typeB, testConstShort);
+    CHECK(testPrescalerOf(typeB) == 0 && *TMR_getPRPointer(typeB) == testConstShort.pr);
+
+    TMR_deinit(typeA);
+    TMR_deinit(pair);
+    TMR_deinit(typeB);
+}
+
+static void testFast(){
+    TimerHandle_t * typeA = Tmr_init(1, 0);
+    TimerHandle_t * pair = Tmr_init(2, 1);
+
+    //the simulator folds SET/CLR writes from outside the driver on a sync only
+    TMRF_setPrescaler(1, 2);
+    TMR_SIM_sync();
+    CHECK(TMRF_getPrescalerShift(1) == 6);
+    TMRF_setPrescaler(1, 1);
+    TMR_SIM_sync();
+    CHECK(TMRF_getPrescalerShift(1) == 3);
+
+    TMRF_writePR(1, 999);
+    CHECK(TMRF_getPeriodCycles(1) == 1000 << 3);
+    CHECK(TMRF_getPeriod_us(1) == 1000 * 8 / CYCLES_PER_us);
+
+    //a pair over the full range doesn't wrap the period
+    CHECK(TMR_setPeriod(pair, 1000000));
+    CHECK(TMRF_getPeriod_us(2) == 1000000);
+    TMRF_writePR(2, 0xffffffff);
+    CHECK(TMRF_getPeriodCycles(2) == 0x100000000ull);
+    CHECK(TMRF_getPeriod_us(2) == 0x100000000ull / CYCLES_PER_us);
+
+    TMRF_writePR(2, 999);
+    TMRF_setEnabled(2, 1);
+    TMR_SIM_sync();
+    CHECK(TMRF_isEnabled(2));
+    TMR_SIM_advance(100);
+    CHECK(TMRF_getCount(2) == 100);
+
+    //in 32bit mode the interrupt is the one of the slave
+    TMRF_setIRQEnabled(2, 1, 1);
+    TMR_SIM_sync();
+    CHECK(TMRF_isIRQEnabled(2, 1) && TMR_isIRQEnabled(pair));
+    TMR_SIM_wait();
+    CHECK(TMRF_readIFS(2, 1));
+    TMRF_clearIFS(2, 1);
+    TMR_SIM_sync();
+    CHECK(!TMRF_readIFS(2, 1));
+    TMRF_setIRQEnabled(2, 1, 0);
+    TMRF_setEnabled(2, 0);
+    TMR_SIM_sync();
+    CHECK(!TMR_isIRQEnabled(pair) && !TMRF_isEnabled(2));
+
+    TMR_deinit(typeA);
+    TMR_deinit(pair);
+}
+
+int main(){
+    //a crashing test should still leave the results of the ones before it
+    setvbuf(stdout, NULL, _IONBF, 0);
+
+    RUN(testSetPeriod);
+    RUN(testCalculatePR);
+    RUN(testCustomDivider);
+    RUN(testFrequency);
+    RUN(testPair);
+    RUN(testStaleHandle);
+    RUN(testIsrBinding);
+#if TMR_PERIOD_QUEUE_SIZE > 0
+    RUN(testPeriodQueue);
+#endif
+#if TMR_ENABLE_SEQUENCER
+    RUN(testSequence);
+#endif
+    RUN(testClockChange);
+    RUN(testSoftTimer);
+    RUN(testDeadline);
+    RUN(testWatchdog);
+
+    RUN(testDefer);
+#if TMR_ENABLE_ISR_STATS && TMR_PERIOD_QUEUE_SIZE > 0
+    RUN(testIsrStats);
+#endif
+    RUN(testDeadlineLifetime);
+    RUN(testGroup);
+    RUN(testMeasure);
+    RUN(testDelay);
+    RUN(testConfigure);
+    RUN(testClockHooks);
+    RUN(testTickless);
+#if TMR_ENABLE_REG_TRACE
+    RUN(testTrace);
+#endif
+    RUN(testTimestamp);
+    RUN(testExec);
+    RUN(testInitAny);
+    RUN(testDeadlineSlack);
+    RUN(testConst);
+    RUN(testFast);
+    printf("%u checks, %u failed\n", checks, failures);
+    return (failures == 0) ? 0 : 1;
+}